@@ -0,0 +1,665 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "../src/core/Console.h"
+#include "../src/core/ContentBlockingManager.h"
+#include "../src/core/ContentBlockingProfile.h"
+#include "../src/core/SessionsManager.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QTextStream>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+#include <QtNetwork/QNetworkRequest>
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace Otter;
+
+struct CorpusEntry
+{
+	QUrl pageUrl;
+	QUrl requestUrl;
+	QByteArray acceptHeader;
+};
+
+// corpus contains one request per line: page URL, request URL and optional Accept header, separated by tabulators
+QVector<CorpusEntry> loadCorpus(const QString &path)
+{
+	QVector<CorpusEntry> corpus;
+	QFile file(path);
+
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		fprintf(stderr, "Failed to open corpus file: %s\n", file.errorString().toLocal8Bit().constData());
+
+		return corpus;
+	}
+
+	QTextStream stream(&file);
+
+	while (!stream.atEnd())
+	{
+		const QString line = stream.readLine();
+
+		if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+		{
+			continue;
+		}
+
+		const QStringList fields = line.split(QLatin1Char('\t'));
+
+		if (fields.count() < 2)
+		{
+			continue;
+		}
+
+		CorpusEntry entry;
+		entry.pageUrl = QUrl(fields.at(0));
+		entry.requestUrl = QUrl(fields.at(1));
+		entry.acceptHeader = ((fields.count() > 2) ? fields.at(2).toLatin1() : QByteArray());
+
+		corpus.append(entry);
+	}
+
+	return corpus;
+}
+
+QStringList getProfilePaths(const QString &path)
+{
+	const QFileInfo information(path);
+
+	if (information.isDir())
+	{
+		const QList<QFileInfo> profiles = QDir(path).entryInfoList(QStringList(QLatin1String("*.txt")), QDir::Files, QDir::Name);
+		QStringList paths;
+
+		for (int i = 0; i < profiles.count(); ++i)
+		{
+			paths.append(profiles.at(i).absoluteFilePath());
+		}
+
+		return paths;
+	}
+
+	return QStringList(information.absoluteFilePath());
+}
+
+// profile without rules would be downloaded from its update address instead of being loaded
+bool hasRules(const QString &path)
+{
+	QFile file(path);
+
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		return false;
+	}
+
+	QTextStream stream(&file);
+	stream.readLine();
+
+	while (!stream.atEnd())
+	{
+		const QString line = stream.readLine().trimmed();
+
+		if (!line.isEmpty() && !line.startsWith(QLatin1Char('!')))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+QSharedPointer<const ContentBlockingProfile::RuleSet> loadRuleSet(ContentBlockingProfile *profile)
+{
+	QEventLoop eventLoop;
+
+	QObject::connect(profile, SIGNAL(profileModified(QString)), &eventLoop, SLOT(quit()));
+	QTimer::singleShot(300000, &eventLoop, SLOT(quit()));
+
+	profile->getRuleSet();
+
+	eventLoop.exec();
+
+	return profile->getRuleSet();
+}
+
+int benchmarkMatcher(const QStringList &paths, const QVector<CorpusEntry> &corpus)
+{
+	int mismatches = 0;
+
+	for (int i = 0; i < paths.count(); ++i)
+	{
+		ContentBlockingProfile profile(paths.at(i));
+		const QSharedPointer<const ContentBlockingProfile::RuleSet> ruleSet = loadRuleSet(&profile);
+		QVector<QPair<QString, int> > keys;
+
+// reference walks over every rule key on its own, so it reports exactly the same candidates as compiled automaton
+		for (int j = 0; j < ruleSet->rules.count(); ++j)
+		{
+			const ContentBlockingProfile::ContentBlockingRule &rule = ruleSet->rules.at(j);
+
+			if (ContentBlockingProfile::getDomainRuleKey(rule).isEmpty())
+			{
+				keys.append(qMakePair(rule.pattern.mid(rule.keyPosition, rule.keyLength), j));
+			}
+		}
+
+		qint64 compiledTime = 0;
+		qint64 referenceTime = 0;
+		int candidates = 0;
+		int profileMismatches = 0;
+
+		for (int j = 0; j < corpus.count(); ++j)
+		{
+			const QString url = corpus.at(j).requestUrl.url();
+			QElapsedTimer timer;
+			timer.start();
+
+			const QVector<ContentBlockingMatcher::Match> matches = ruleSet->matcher.match(url);
+
+			compiledTime += timer.nsecsElapsed();
+
+			timer.restart();
+
+			QVector<QPair<int, int> > referenceMatches;
+
+			for (int k = 0; k < keys.count(); ++k)
+			{
+				int position = url.indexOf(keys.at(k).first);
+
+				while (position >= 0)
+				{
+					referenceMatches.append(qMakePair(keys.at(k).second, position));
+
+					position = url.indexOf(keys.at(k).first, (position + 1));
+				}
+			}
+
+			referenceTime += timer.nsecsElapsed();
+
+			QVector<QPair<int, int> > compiledMatches;
+			compiledMatches.reserve(matches.count());
+
+			for (int k = 0; k < matches.count(); ++k)
+			{
+				compiledMatches.append(qMakePair(matches.at(k).identifier, matches.at(k).position));
+			}
+
+			std::sort(compiledMatches.begin(), compiledMatches.end());
+			std::sort(referenceMatches.begin(), referenceMatches.end());
+
+			if (compiledMatches != referenceMatches)
+			{
+				++profileMismatches;
+
+				fprintf(stderr, "Candidates mismatch for %s: %d compiled, %d reference\n", url.toLocal8Bit().constData(), compiledMatches.count(), referenceMatches.count());
+			}
+
+			candidates += compiledMatches.count();
+		}
+
+		printf("%s: %d rules, %d keys, %d candidates, automaton %.1f us/request, reference %.1f us/request, %d mismatches\n", QFileInfo(paths.at(i)).fileName().toLocal8Bit().constData(), ruleSet->rules.count(), keys.count(), candidates, (corpus.isEmpty() ? 0.0 : (compiledTime / 1000.0 / corpus.count())), (corpus.isEmpty() ? 0.0 : (referenceTime / 1000.0 / corpus.count())), profileMismatches);
+
+		mismatches += profileMismatches;
+	}
+
+	return ((mismatches > 0) ? 1 : 0);
+}
+
+QRegularExpression createRuleExpression(const ContentBlockingProfile::ContentBlockingRule &rule)
+{
+	QString expression;
+
+	if (rule.needsDomainCheck)
+	{
+		expression = QLatin1String("^[\\w+.-]+://(?:[^/?#@]*@)?(?:[^/?#:@]*\\.)?");
+	}
+	else if (rule.ruleMatch == ContentBlockingProfile::StartMatch || rule.ruleMatch == ContentBlockingProfile::ExactMatch)
+	{
+		expression = QLatin1String("^");
+	}
+
+	for (int i = 0; i < rule.pattern.length(); ++i)
+	{
+		if (rule.pattern.at(i) == QLatin1Char('*'))
+		{
+			expression += QLatin1String(".*");
+		}
+		else if (rule.pattern.at(i) == QLatin1Char('^'))
+		{
+			expression += QLatin1String("(?:[^\\w.%-]|$)");
+		}
+		else
+		{
+			expression += QRegularExpression::escape(QString(rule.pattern.at(i)));
+		}
+	}
+
+	if (rule.ruleMatch == ContentBlockingProfile::EndMatch || rule.ruleMatch == ContentBlockingProfile::ExactMatch)
+	{
+		expression += QLatin1Char('$');
+	}
+
+// domain rules are compared with lowercase host, so their case is not significant
+	return QRegularExpression(expression, (ContentBlockingProfile::getDomainRuleKey(rule).isEmpty() ? QRegularExpression::UseUnicodePropertiesOption : (QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption)));
+}
+
+int benchmarkPatterns(const QStringList &paths, const QVector<CorpusEntry> &corpus)
+{
+	int mismatches = 0;
+
+	for (int i = 0; i < paths.count(); ++i)
+	{
+		ContentBlockingProfile profile(paths.at(i));
+		const QSharedPointer<const ContentBlockingProfile::RuleSet> ruleSet = loadRuleSet(&profile);
+		QHash<int, QRegularExpression> expressions;
+		QVector<int> domainRules;
+		qint64 engineTime = 0;
+		qint64 expressionTime = 0;
+		int checks = 0;
+		int profileMismatches = 0;
+
+		for (int j = 0; j < ruleSet->rules.count(); ++j)
+		{
+			if (!ContentBlockingProfile::getDomainRuleKey(ruleSet->rules.at(j)).isEmpty())
+			{
+				domainRules.append(j);
+			}
+		}
+
+		for (int j = 0; j < corpus.count(); ++j)
+		{
+			QNetworkRequest request(corpus.at(j).requestUrl);
+
+			if (!corpus.at(j).acceptHeader.isEmpty())
+			{
+				request.setRawHeader(QByteArray("Accept"), corpus.at(j).acceptHeader);
+			}
+
+			const QString url = corpus.at(j).requestUrl.url();
+			const QString host = corpus.at(j).requestUrl.host();
+			const ContentBlockingProfile::RequestInformation information = ContentBlockingProfile::getRequestInformation(request, url, corpus.at(j).pageUrl);
+			const QVector<ContentBlockingMatcher::Match> matches = ruleSet->matcher.match(url);
+			QVector<QPair<int, int> > candidates;
+
+			for (int k = 0; k < matches.count(); ++k)
+			{
+				candidates.append(qMakePair(matches.at(k).identifier, matches.at(k).position));
+			}
+
+			for (int k = 0; k < domainRules.count(); ++k)
+			{
+				const ContentBlockingProfile::ContentBlockingRule &rule = ruleSet->rules.at(domainRules.at(k));
+
+				if (host.contains(rule.pattern.left(rule.keyLength), Qt::CaseInsensitive))
+				{
+					candidates.append(qMakePair(domainRules.at(k), -1));
+				}
+			}
+
+			QHash<int, bool> engineResults;
+
+			for (int k = 0; k < candidates.count(); ++k)
+			{
+				const ContentBlockingProfile::ContentBlockingRule &rule = ruleSet->rules.at(candidates.at(k).first);
+
+// options are checked by both paths in the same way, only patterns are compared
+				if (!ContentBlockingProfile::checkRuleOptions(rule, information.options, information.baseHost))
+				{
+					continue;
+				}
+
+				QElapsedTimer timer;
+				timer.start();
+
+				bool engineResult = false;
+
+				if (candidates.at(k).second < 0)
+				{
+					const QString domain = rule.pattern.left(rule.keyLength).toLower();
+
+					engineResult = (host == domain || host.endsWith(QLatin1Char('.') + domain));
+				}
+				else
+				{
+					engineResult = ContentBlockingProfile::checkRuleMatch(rule, information, candidates.at(k).second);
+				}
+
+				engineTime += timer.nsecsElapsed();
+
+// key can occur several times, rule matches if any of these occurrences is confirmed
+				engineResults[candidates.at(k).first] = (engineResults.value(candidates.at(k).first, false) || engineResult);
+			}
+
+			QHash<int, bool>::const_iterator iterator;
+
+			for (iterator = engineResults.constBegin(); iterator != engineResults.constEnd(); ++iterator)
+			{
+				const ContentBlockingProfile::ContentBlockingRule &rule = ruleSet->rules.at(iterator.key());
+
+				if (!expressions.contains(iterator.key()))
+				{
+					expressions[iterator.key()] = createRuleExpression(rule);
+				}
+
+				QElapsedTimer timer;
+				timer.start();
+
+				const bool expressionResult = expressions[iterator.key()].match(url).hasMatch();
+
+				expressionTime += timer.nsecsElapsed();
+
+				++checks;
+
+				if (iterator.value() != expressionResult)
+				{
+					++profileMismatches;
+
+					fprintf(stderr, "Pattern mismatch for rule %s on %s: engine %d, expression %d\n", rule.pattern.toLocal8Bit().constData(), url.toLocal8Bit().constData(), iterator.value(), expressionResult);
+				}
+			}
+		}
+
+		printf("%s: %d checks, engine %.1f us/request, expressions %.1f us/request, %d mismatches\n", QFileInfo(paths.at(i)).fileName().toLocal8Bit().constData(), checks, (engineTime / 1000.0 / corpus.count()), (expressionTime / 1000.0 / corpus.count()), profileMismatches);
+
+		mismatches += profileMismatches;
+	}
+
+	return ((mismatches > 0) ? 1 : 0);
+}
+
+qint64 getResidentMemory()
+{
+	QFile file(QLatin1String("/proc/self/status"));
+
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		return -1;
+	}
+
+	while (!file.atEnd())
+	{
+		const QByteArray line = file.readLine();
+
+		if (line.startsWith("VmRSS:"))
+		{
+			return line.mid(6).trimmed().split(' ').first().toLongLong();
+		}
+	}
+
+	return -1;
+}
+
+int replayCorpus(const QStringList &sourcePaths, const QVector<CorpusEntry> &corpus, const QString &verdictsPath)
+{
+	const qint64 initialMemory = getResidentMemory();
+	QElapsedTimer timer;
+	timer.start();
+
+// lists are placed where manager looks for them, bundled ones contain no rules and are never used, since loading them would require network
+	const QDir blockingDirectory(SessionsManager::getWritableDataPath(QLatin1String("blocking")));
+	QStringList names;
+
+	QDir().mkpath(blockingDirectory.path());
+
+	for (int i = 0; i < sourcePaths.count(); ++i)
+	{
+		QFile::copy(sourcePaths.at(i), blockingDirectory.filePath(QFileInfo(sourcePaths.at(i)).fileName()));
+
+		names.append(QFileInfo(sourcePaths.at(i)).baseName());
+	}
+
+	ContentBlockingManager::createInstance(QCoreApplication::instance());
+
+	const QList<ContentBlockingProfile*> allProfiles = ContentBlockingManager::getInstance()->findChildren<ContentBlockingProfile*>();
+	QList<ContentBlockingProfile*> profiles;
+
+	for (int i = 0; i < allProfiles.count(); ++i)
+	{
+		if (!names.contains(allProfiles.at(i)->getInformation().name))
+		{
+			continue;
+		}
+
+		if (!hasRules(allProfiles.at(i)->getInformation().path))
+		{
+			fprintf(stderr, "Profile contains no rules: %s\n", allProfiles.at(i)->getInformation().path.toLocal8Bit().constData());
+
+			return 2;
+		}
+
+		allProfiles.at(i)->isReady();
+
+		profiles.append(allProfiles.at(i));
+	}
+
+	for (int i = 0; i < profiles.count(); ++i)
+	{
+		while (!profiles.at(i)->isReady())
+		{
+			if (timer.elapsed() > 300000)
+			{
+				fprintf(stderr, "Timed out while loading profile: %s\n", profiles.at(i)->getInformation().path.toLocal8Bit().constData());
+
+				return 2;
+			}
+
+			QEventLoop eventLoop;
+
+			QObject::connect(profiles.at(i), SIGNAL(profileModified(QString)), &eventLoop, SLOT(quit()));
+			QTimer::singleShot(1000, &eventLoop, SLOT(quit()));
+
+			eventLoop.exec();
+		}
+	}
+
+	const qint64 parseTime = timer.elapsed();
+	const QVector<int> profileList = ContentBlockingManager::getProfileList(names);
+	QNetworkRequest warmupRequest(corpus.first().requestUrl);
+
+// first request schedules compilation of merged index, which is waited for so it is not measured as part of replay
+	ContentBlockingManager::isUrlBlocked(profileList, warmupRequest, corpus.first().pageUrl);
+
+	QThreadPool::globalInstance()->waitForDone();
+
+	const qint64 indexTime = timer.elapsed();
+	const qint64 loadedMemory = getResidentMemory();
+	QVector<qint64> times;
+	QVector<bool> verdicts;
+	int blocked = 0;
+
+	times.reserve(corpus.count());
+	verdicts.reserve(corpus.count());
+
+	for (int i = 0; i < corpus.count(); ++i)
+	{
+		QNetworkRequest request(corpus.at(i).requestUrl);
+
+		if (!corpus.at(i).acceptHeader.isEmpty())
+		{
+			request.setRawHeader(QByteArray("Accept"), corpus.at(i).acceptHeader);
+		}
+
+		timer.restart();
+
+		const bool isBlocked = ContentBlockingManager::isUrlBlocked(profileList, request, corpus.at(i).pageUrl);
+
+		times.append(timer.nsecsElapsed());
+		verdicts.append(isBlocked);
+
+		if (isBlocked)
+		{
+			++blocked;
+		}
+	}
+
+	QVector<qint64> sortedTimes(times);
+	qint64 totalTime = 0;
+
+	std::sort(sortedTimes.begin(), sortedTimes.end());
+
+	for (int i = 0; i < sortedTimes.count(); ++i)
+	{
+		totalTime += sortedTimes.at(i);
+	}
+
+	printf("Profiles: %d, parse time: %lld ms, merged index compiled after: %lld ms\n", profiles.count(), parseTime, indexTime);
+
+	if (initialMemory >= 0 && loadedMemory >= 0)
+	{
+		printf("Memory footprint: %lld KiB\n", (loadedMemory - initialMemory));
+	}
+	else
+	{
+		printf("Memory footprint: not available on this platform\n");
+	}
+
+	printf("Requests: %d, blocked: %d, decision cache hits: %llu, misses: %llu\n", corpus.count(), blocked, ContentBlockingManager::getDecisionCacheHits(), ContentBlockingManager::getDecisionCacheMisses());
+	printf("Latency: mean %.1f us, p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n", (totalTime / 1000.0 / sortedTimes.count()), (sortedTimes.at(sortedTimes.count() / 2) / 1000.0), (sortedTimes.at((sortedTimes.count() * 90) / 100) / 1000.0), (sortedTimes.at((sortedTimes.count() * 99) / 100) / 1000.0), (sortedTimes.last() / 1000.0));
+
+	if (verdictsPath.isEmpty())
+	{
+		return 0;
+	}
+
+	QFile verdictsFile(verdictsPath);
+
+// verdicts are written by first run and following runs are compared with them
+	if (!verdictsFile.exists())
+	{
+		if (!verdictsFile.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			fprintf(stderr, "Failed to write verdicts: %s\n", verdictsFile.errorString().toLocal8Bit().constData());
+
+			return 2;
+		}
+
+		QTextStream stream(&verdictsFile);
+
+		for (int i = 0; i < corpus.count(); ++i)
+		{
+			stream << (verdicts.at(i) ? '1' : '0') << '\t' << corpus.at(i).requestUrl.url() << '\n';
+		}
+
+		printf("Verdicts written to %s\n", verdictsPath.toLocal8Bit().constData());
+
+		return 0;
+	}
+
+	if (!verdictsFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		fprintf(stderr, "Failed to read verdicts: %s\n", verdictsFile.errorString().toLocal8Bit().constData());
+
+		return 2;
+	}
+
+	QTextStream stream(&verdictsFile);
+	int differences = 0;
+
+	for (int i = 0; i < corpus.count(); ++i)
+	{
+		const QString line = stream.readLine();
+
+		if (line.isNull())
+		{
+			fprintf(stderr, "Reference contains only %d verdicts\n", i);
+
+			return 1;
+		}
+
+		if (line.startsWith(QLatin1Char('1')) != verdicts.at(i))
+		{
+			++differences;
+
+			printf("%s: %s, reference: %s\n", corpus.at(i).requestUrl.url().toLocal8Bit().constData(), (verdicts.at(i) ? "blocked" : "allowed"), (verdicts.at(i) ? "allowed" : "blocked"));
+		}
+	}
+
+	printf("Differences from reference: %d\n", differences);
+
+	return ((differences > 0) ? 1 : 0);
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication application(argc, argv);
+
+	Q_INIT_RESOURCE(resources);
+
+	const QStringList arguments = application.arguments();
+	const QString mode = ((arguments.count() > 1) ? arguments.at(1) : QString());
+	const bool isReplay = (mode == QLatin1String("replay"));
+
+	if (arguments.count() < 4 || (!isReplay && mode != QLatin1String("matcher") && mode != QLatin1String("patterns")))
+	{
+		fprintf(stderr, "Usage: %s matcher|patterns <profile file or directory> <corpus file>\n", argv[0]);
+		fprintf(stderr, "       %s replay <profile file or directory> <corpus file> [<verdicts file>]\n", argv[0]);
+
+		return 2;
+	}
+
+	const QVector<CorpusEntry> corpus = loadCorpus(arguments.at(3));
+
+	if (corpus.isEmpty())
+	{
+		fprintf(stderr, "Corpus is empty\n");
+
+		return 2;
+	}
+
+// profiles store their caches and settings next to lists, so copies are used to keep sources untouched
+	QTemporaryDir profileDirectory;
+
+	Console::createInstance(&application);
+	SessionsManager::createInstance(profileDirectory.path(), QDir(profileDirectory.path()).filePath(QLatin1String("cache")), true, &application);
+
+	const QStringList sourcePaths = getProfilePaths(arguments.at(2));
+
+	if (isReplay)
+	{
+		return replayCorpus(sourcePaths, corpus, ((arguments.count() > 4) ? arguments.at(4) : QString()));
+	}
+
+	QStringList paths;
+
+	for (int i = 0; i < sourcePaths.count(); ++i)
+	{
+		const QString path = QDir(profileDirectory.path()).filePath(QFileInfo(sourcePaths.at(i)).fileName());
+
+		QFile::copy(sourcePaths.at(i), path);
+
+		paths.append(path);
+	}
+
+	if (mode == QLatin1String("patterns"))
+	{
+		return benchmarkPatterns(paths, corpus);
+	}
+
+	return benchmarkMatcher(paths, corpus);
+}
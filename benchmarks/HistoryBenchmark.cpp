@@ -0,0 +1,195 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "../src/core/HistoryDatabase.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTemporaryDir>
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace Otter;
+
+// visits are spread over one year, most of them go to small part of locations like in real history
+void populateDatabase(HistoryDatabase *database, int amount, uint now)
+{
+	const int hostsAmount = qMax(1, (amount / 200));
+	const int locationsAmount = qMax(1, (amount / 4));
+	const uint period = (365 * 86400);
+	QList<HistoryVisit> visits;
+	QElapsedTimer timer;
+	timer.start();
+
+	qsrand(1);
+
+	for (int i = 0; i < amount; ++i)
+	{
+		const int location = (((qrand() % 4) == 0) ? (qrand() % locationsAmount) : (qrand() % qMax(1, (locationsAmount / 100))));
+
+		HistoryVisit visit;
+		visit.host = QStringLiteral("host%1.example.com").arg(location % hostsAmount);
+		visit.scheme = QLatin1String("http");
+		visit.path = QStringLiteral("/path/%1").arg(location);
+		visit.title = QStringLiteral("Page %1 of host %2").arg(location).arg(location % hostsAmount);
+		visit.identifier = (i + 1);
+		visit.time = (now - period + static_cast<uint>((static_cast<quint64>(i) * period) / amount));
+		visit.typed = ((qrand() % 10) == 0);
+
+		visits.append(visit);
+
+		if (visits.count() == 10000 || i == (amount - 1))
+		{
+			database->addVisits(visits, QList<HistoryNotification>());
+
+			visits.clear();
+		}
+	}
+
+	printf("populating: %d visits in %.1f s\n", amount, (timer.elapsed() / 1000.0));
+}
+
+QList<qint64> getOldestEntries(int limit)
+{
+	QList<qint64> entries;
+	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
+	query.exec(QStringLiteral("SELECT \"id\" FROM \"visits\" ORDER BY \"time\" ASC LIMIT %1;").arg(limit));
+
+	while (query.next())
+	{
+		entries.append(query.value(0).toLongLong());
+	}
+
+	return entries;
+}
+
+// each operation is repeated, so results are not dominated by cold page cache
+void benchmarkQueries(HistoryDatabase *database, const char *label, uint now)
+{
+	const int iterations = 20;
+	QElapsedTimer timer;
+	timer.start();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		const uint end = (now - (static_cast<uint>(i) * 7 * 86400));
+
+		database->loadEntries(0, (end - 86400), end, 0, -1, 100);
+	}
+
+	const qint64 dayTime = timer.nsecsElapsed();
+
+	timer.restart();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		database->loadFrequentEntries(0, 20);
+	}
+
+	const qint64 frequentTime = timer.nsecsElapsed();
+
+	timer.restart();
+
+	database->loadLocations();
+
+	const qint64 locationsTime = timer.nsecsElapsed();
+	qint64 removeTime = 0;
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		const QList<qint64> entries = getOldestEntries(500);
+
+		timer.restart();
+
+		QSqlDatabase::database(QLatin1String("browsingHistory")).transaction();
+
+		database->removeVisits(entries);
+
+		QSqlDatabase::database(QLatin1String("browsingHistory")).commit();
+
+		removeTime += timer.nsecsElapsed();
+	}
+
+	printf("%s: day listing %.2f ms, frequent locations %.2f ms, locations filter %.2f ms, removing 500 oldest visits %.2f ms\n", label, (dayTime / 1000000.0 / iterations), (frequentTime / 1000000.0 / iterations), (locationsTime / 1000000.0), (removeTime / 1000000.0 / iterations));
+}
+
+bool compareStatistics(const SqlStatementCache::StatementStatistics &first, const SqlStatementCache::StatementStatistics &second)
+{
+	return (first.time > second.time);
+}
+
+// counters of prepared statements are cumulative and kept in microseconds, so they cover all operations done so far
+void printStatistics(HistoryDatabase *database)
+{
+	QList<SqlStatementCache::StatementStatistics> statistics = database->getStatementStatistics();
+
+	std::sort(statistics.begin(), statistics.end(), compareStatistics);
+
+	printf("statements by total time:\n");
+
+	for (int i = 0; i < statistics.count(); ++i)
+	{
+		const SqlStatementCache::StatementStatistics &statementStatistics = statistics.at(i);
+
+		printf("%10.2f ms %8lld runs %10.3f ms/run  %s\n", (statementStatistics.time / 1000.0), statementStatistics.executions, ((statementStatistics.executions > 0) ? (statementStatistics.time / 1000.0 / statementStatistics.executions) : 0.0), statementStatistics.statement.left(120).toLocal8Bit().constData());
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication application(argc, argv);
+
+	Q_INIT_RESOURCE(resources);
+
+	const QStringList arguments = application.arguments();
+	const int amount = ((arguments.count() > 1) ? arguments.at(1).toInt() : 1000000);
+
+	if (amount <= 0)
+	{
+		fprintf(stderr, "Usage: %s [<visits amount>]\n", argv[0]);
+
+		return 2;
+	}
+
+	QTemporaryDir directory;
+	HistoryDatabase database;
+	const uint now = QDateTime::currentDateTime().toTime_t();
+
+	database.open(QDir(directory.path()).filePath(QLatin1String("browsingHistory.sqlite")), QLatin1String("WAL"));
+
+	populateDatabase(&database, amount, now);
+	benchmarkQueries(&database, "indexed", now);
+	printStatistics(&database);
+
+// same operations without indexes added by schema version 2, to show what they are worth
+	QSqlDatabase sqlDatabase = QSqlDatabase::database(QLatin1String("browsingHistory"));
+	sqlDatabase.exec(QLatin1String("DROP INDEX \"visits_time\";"));
+	sqlDatabase.exec(QLatin1String("DROP INDEX \"visits_location\";"));
+	sqlDatabase.exec(QLatin1String("DROP INDEX \"visits_icon\";"));
+
+	benchmarkQueries(&database, "unindexed", now);
+	printStatistics(&database);
+
+	database.close();
+
+	return 0;
+}
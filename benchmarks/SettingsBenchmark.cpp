@@ -0,0 +1,144 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "../src/core/SettingsManager.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QSettings>
+#include <QtCore/QTemporaryDir>
+
+#include <cstdio>
+
+using namespace Otter;
+
+// profile resembles real one, few dozens of groups with several options each and overrides for some hosts
+void createProfile(const QString &path, QStringList *keys)
+{
+	QSettings globalSettings(QDir(path).filePath(QLatin1String("otter.conf")), QSettings::IniFormat);
+	QSettings overrideSettings(QDir(path).filePath(QLatin1String("override.ini")), QSettings::IniFormat);
+
+	for (int i = 0; i < 30; ++i)
+	{
+		for (int j = 0; j < 8; ++j)
+		{
+			const QString key = QStringLiteral("Group%1/Option%2").arg(i).arg(j);
+
+			keys->append(key);
+
+			globalSettings.setValue(key, QStringLiteral("value%1").arg(j));
+		}
+	}
+
+	for (int i = 0; i < 50; ++i)
+	{
+		overrideSettings.setValue(QStringLiteral("host%1.example.com/%2").arg(i).arg(keys->at(i % keys->count())), QLatin1String("override"));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication application(argc, argv);
+
+	const QStringList arguments = application.arguments();
+	const int iterations = ((arguments.count() > 1) ? arguments.at(1).toInt() : 100000);
+
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "Usage: %s [<lookups amount>]\n", argv[0]);
+
+		return 2;
+	}
+
+	QTemporaryDir directory;
+	QStringList keys;
+
+	createProfile(directory.path(), &keys);
+
+	const QString globalPath = QDir(directory.path()).filePath(QLatin1String("otter.conf"));
+	const QString overridePath = QDir(directory.path()).filePath(QLatin1String("override.ini"));
+	const QUrl url(QLatin1String("http://www.host1.example.com/"));
+	QElapsedTimer timer;
+	timer.start();
+
+// previous implementation constructed QSettings for global file and for overrides on each lookup
+	const int settingsIterations = qMax(1, (iterations / 100));
+
+	for (int i = 0; i < settingsIterations; ++i)
+	{
+		const QString &key = keys.at(i % keys.count());
+		QSettings overrideSettings(overridePath, QSettings::IniFormat);
+
+		if (!overrideSettings.contains(url.host() + QLatin1Char('/') + key))
+		{
+			QSettings globalSettings(globalPath, QSettings::IniFormat);
+			globalSettings.value(key);
+		}
+	}
+
+	const qint64 settingsTime = timer.nsecsElapsed();
+
+	SettingsManager::createInstance(directory.path(), &application);
+
+	for (int i = 0; i < keys.count(); ++i)
+	{
+		SettingsManager::setDefaultValue(keys.at(i), QLatin1String("default"));
+	}
+
+	timer.restart();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		SettingsManager::getValue(keys.at(i % keys.count()));
+	}
+
+	const qint64 keyTime = timer.nsecsElapsed();
+	QVector<int> identifiers;
+
+	for (int i = 0; i < keys.count(); ++i)
+	{
+		identifiers.append(SettingsManager::getOptionIdentifier(keys.at(i)));
+	}
+
+	timer.restart();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		SettingsManager::getValue(identifiers.at(i % identifiers.count()));
+	}
+
+	const qint64 identifierTime = timer.nsecsElapsed();
+
+	timer.restart();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		SettingsManager::getValue(keys.at(i % keys.count()), url);
+	}
+
+	const qint64 urlTime = timer.nsecsElapsed();
+
+	printf("QSettings per lookup: %.3f us\n", (settingsTime / 1000.0 / settingsIterations));
+	printf("SettingsManager by key: %.3f us\n", (keyTime / 1000.0 / iterations));
+	printf("SettingsManager by identifier: %.3f us\n", (identifierTime / 1000.0 / iterations));
+	printf("SettingsManager by key with overrides: %.3f us\n", (urlTime / 1000.0 / iterations));
+
+	return 0;
+}
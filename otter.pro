@@ -44,13 +44,16 @@ SOURCES += src/main.cpp \
     src/core/BookmarksManager.cpp \
     src/core/BookmarksModel.cpp \
     src/core/ContentBlockingManager.cpp \
+    src/core/ContentBlockingMatcher.cpp \
     src/core/ContentBlockingProfile.cpp \
     src/core/Console.cpp \
     src/core/CookieJar.cpp \
     src/core/CookieJarProxy.cpp \
     src/core/FileSystemCompleterModel.cpp \
     src/core/GesturesManager.cpp \
+    src/core/HistoryDatabase.cpp \
     src/core/HistoryManager.cpp \
+    src/core/HistoryModel.cpp \
     src/core/Importer.cpp \
     src/core/InputInterpreter.cpp \
     src/core/LocalListingNetworkReply.cpp \
@@ -58,6 +61,7 @@ SOURCES += src/main.cpp \
     src/core/NetworkManagerFactory.cpp \
     src/core/NetworkAutomaticProxy.cpp \
     src/core/NetworkCache.cpp \
+    src/core/NetworkCacheCleaner.cpp \
     src/core/NetworkProxyFactory.cpp \
     src/core/NotesManager.cpp \
     src/core/NotificationsManager.cpp \
@@ -67,6 +71,7 @@ SOURCES += src/main.cpp \
     src/core/SessionModel.cpp \
     src/core/SessionsManager.cpp \
     src/core/SettingsManager.cpp \
+    src/core/SqlStatementCache.cpp \
     src/core/ToolBarsManager.cpp \
     src/core/Transfer.cpp \
     src/core/TransfersManager.cpp \
@@ -181,18 +186,22 @@ HEADERS += src/core/ActionsManager.h \
     src/core/BookmarksManager.h \
     src/core/BookmarksModel.h \
     src/core/ContentBlockingManager.h \
+    src/core/ContentBlockingMatcher.h \
     src/core/ContentBlockingProfile.h \
     src/core/Console.h \
     src/core/CookieJar.h \
     src/core/CookieJarProxy.h \
     src/core/FileSystemCompleterModel.h \
     src/core/GesturesManager.h \
+    src/core/HistoryDatabase.h \
     src/core/HistoryManager.h \
+    src/core/HistoryModel.h \
     src/core/Importer.h \
     src/core/InputInterpreter.h \
     src/core/LocalListingNetworkReply.h \
     src/core/NetworkAutomaticProxy.h \
     src/core/NetworkCache.h \
+    src/core/NetworkCacheCleaner.h \
     src/core/NetworkManager.h \
     src/core/NetworkManagerFactory.h \
     src/core/NetworkProxyFactory.h \
@@ -204,6 +213,7 @@ HEADERS += src/core/ActionsManager.h \
     src/core/SessionModel.h \
     src/core/SessionsManager.h \
     src/core/SettingsManager.h \
+    src/core/SqlStatementCache.h \
     src/core/ToolBarsManager.h \
     src/core/Transfer.h \
     src/core/TransfersManager.h \
@@ -1,4 +1,17 @@
+PRAGMA auto_vacuum = INCREMENTAL;
 CREATE TABLE "visits" ("id" INTEGER PRIMARY KEY, "location" INTEGER NOT NULL, "icon" INTEGER NOT NULL, "title" TEXT, "time" INTEGER NOT NULL, "typed" BOOLEAN NOT NULL);
-CREATE TABLE "locations" ("id" INTEGER PRIMARY KEY, "host" INTEGER NOT NULL, "scheme" TEXT NOT NULL, "path" TEXT, UNIQUE("host", "scheme", "path"));
+CREATE TABLE "locations" ("id" INTEGER PRIMARY KEY, "host" INTEGER NOT NULL, "scheme" TEXT NOT NULL, "path" TEXT, "visits" INTEGER NOT NULL DEFAULT 0, UNIQUE("host", "scheme", "path"));
 CREATE TABLE "hosts" ("id" INTEGER PRIMARY KEY, "host" TEXT UNIQUE NOT NULL);
-CREATE TABLE "icons" ("id" INTEGER PRIMARY KEY, "icon" BLOB UNIQUE NOT NULL);
+CREATE TABLE "icons" ("id" INTEGER PRIMARY KEY, "hash" INTEGER NOT NULL, "icon" BLOB NOT NULL);
+CREATE INDEX "visits_time" ON "visits" ("time");
+CREATE INDEX "visits_location" ON "visits" ("location");
+CREATE INDEX "visits_icon" ON "visits" ("icon");
+CREATE INDEX "icons_hash" ON "icons" ("hash");
+CREATE TRIGGER "visits_insert" AFTER INSERT ON "visits" BEGIN UPDATE "locations" SET "visits" = ("visits" + 1) WHERE "id" = NEW."location"; END;
+CREATE TRIGGER "visits_delete" AFTER DELETE ON "visits" BEGIN UPDATE "locations" SET "visits" = ("visits" - 1) WHERE "id" = OLD."location"; END;
+CREATE TRIGGER "visits_update" AFTER UPDATE OF "location" ON "visits" WHEN NEW."location" <> OLD."location" BEGIN UPDATE "locations" SET "visits" = ("visits" - 1) WHERE "id" = OLD."location"; UPDATE "locations" SET "visits" = ("visits" + 1) WHERE "id" = NEW."location"; END;
+CREATE TRIGGER "visits_delete_icon" AFTER DELETE ON "visits" WHEN OLD."icon" > 0 BEGIN DELETE FROM "icons" WHERE "id" = OLD."icon" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "icon" = OLD."icon"); END;
+CREATE TRIGGER "visits_update_icon" AFTER UPDATE OF "icon" ON "visits" WHEN OLD."icon" > 0 AND NEW."icon" <> OLD."icon" BEGIN DELETE FROM "icons" WHERE "id" = OLD."icon" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "icon" = OLD."icon"); END;
+CREATE TRIGGER "locations_unused" AFTER UPDATE OF "visits" ON "locations" WHEN NEW."visits" <= 0 BEGIN DELETE FROM "locations" WHERE "id" = NEW."id"; END;
+CREATE TRIGGER "locations_delete" AFTER DELETE ON "locations" BEGIN DELETE FROM "hosts" WHERE "id" = OLD."host" AND NOT EXISTS(SELECT 1 FROM "locations" WHERE "host" = OLD."host"); END;
+PRAGMA user_version = 4;
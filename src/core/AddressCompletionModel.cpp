@@ -19,7 +19,12 @@
 
 #include "AddressCompletionModel.h"
 #include "BookmarksManager.h"
+#include "HistoryManager.h"
+#include "SessionsManager.h"
 #include "SettingsManager.h"
+#include "WindowsManager.h"
+#include "../ui/MainWindow.h"
+#include "../ui/Window.h"
 
 #include <QtCore/QCoreApplication>
 
@@ -29,11 +34,17 @@ namespace Otter
 AddressCompletionModel* AddressCompletionModel::m_instance = NULL;
 
 AddressCompletionModel::AddressCompletionModel(QObject *parent) : QAbstractListModel(parent),
+	m_historyRequest(-1),
+	m_searchRequest(-1),
 	m_updateTimer(0)
 {
 	m_updateTimer = startTimer(250);
 
-	connect(BookmarksManager::getModel(), SIGNAL(modelModified()), this, SLOT(updateCompletion()));
+	connect(BookmarksManager::getModel(), SIGNAL(modelModified()), this, SLOT(updateBookmarks()));
+	connect(HistoryManager::getInstance(), SIGNAL(cleared()), this, SLOT(updateCompletion()));
+	connect(HistoryManager::getInstance(), SIGNAL(entriesLoaded(int,QList<HistoryRecord>)), this, SLOT(addHistoryEntries(int,QList<HistoryRecord>)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryAdded(qint64)), this, SLOT(addHistoryEntry(qint64)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryRemoved(qint64)), this, SLOT(removeHistoryEntry(qint64)));
 	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString)));
 }
 
@@ -45,15 +56,55 @@ void AddressCompletionModel::timerEvent(QTimerEvent *event)
 
 		m_updateTimer = 0;
 
-		QList<QUrl> urls;
-		urls << QUrl(QLatin1String("about:bookmarks")) << QUrl(QLatin1String("about:cache")) << QUrl(QLatin1String("about:config")) << QUrl(QLatin1String("about:cookies")) << QUrl(QLatin1String("about:history")) << QUrl(QLatin1String("about:notes")) << QUrl(QLatin1String("about:transfers"));
-		urls << BookmarksManager::getUrls();
+// previous index is kept until most frequently visited locations arrive, so suggestions do not disappear meanwhile
+		if (SettingsManager::getValue(QLatin1String("AddressField/SuggestHistory")).toBool())
+		{
+			m_historyRequest = HistoryManager::requestFrequentEntries(5000);
+		}
+		else
+		{
+			m_historyRequest = -1;
 
-		beginResetModel();
+			rebuildIndex(QList<HistoryRecord>());
+		}
+	}
+}
+
+void AddressCompletionModel::rebuildIndex(const QList<HistoryRecord> &entries)
+{
+	m_entries.clear();
+	m_historyEntries.clear();
+	m_index.clear();
 
-		m_urls = urls;
+	QList<QUrl> urls;
+	urls << QUrl(QLatin1String("about:bookmarks")) << QUrl(QLatin1String("about:cache")) << QUrl(QLatin1String("about:config")) << QUrl(QLatin1String("about:cookies")) << QUrl(QLatin1String("about:history")) << QUrl(QLatin1String("about:notes")) << QUrl(QLatin1String("about:transfers"));
+
+	for (int i = 0; i < urls.count(); ++i)
+	{
+		addEntry(urls.at(i));
+	}
+
+	if (SettingsManager::getValue(QLatin1String("AddressField/SuggestBookmarks")).toBool())
+	{
+		urls = BookmarksManager::getUrls();
+
+		for (int i = 0; i < urls.count(); ++i)
+		{
+			addEntry(urls.at(i), 0, 0, true);
+		}
+	}
+
+	for (int i = 0; i < entries.count(); ++i)
+	{
+		addEntry(entries.at(i).url, entries.at(i).time.toTime_t(), entries.at(i).visits, false, entries.at(i).typed);
 
-		endResetModel();
+		m_historyEntries[entries.at(i).identifier] = entries.at(i).url.toString();
+	}
+
+	if (!m_filter.isEmpty())
+	{
+		updateOpenUrls();
+		updateMatches();
 	}
 }
 
@@ -73,6 +124,335 @@ void AddressCompletionModel::updateCompletion()
 	}
 }
 
+void AddressCompletionModel::updateBookmarks()
+{
+	QSet<QString> bookmarks;
+
+	if (SettingsManager::getValue(QLatin1String("AddressField/SuggestBookmarks")).toBool())
+	{
+		const QList<QUrl> urls = BookmarksManager::getUrls();
+
+		for (int i = 0; i < urls.count(); ++i)
+		{
+			bookmarks.insert(urls.at(i).toString());
+
+			addEntry(urls.at(i), 0, 0, true);
+		}
+	}
+
+	QStringList removedKeys;
+	QHash<QString, CompletionEntry>::iterator iterator;
+
+	for (iterator = m_entries.begin(); iterator != m_entries.end(); ++iterator)
+	{
+		if (iterator.value().isBookmark && !bookmarks.contains(iterator.key()))
+		{
+			iterator.value().isBookmark = false;
+
+			if (iterator.value().visits <= 0 && iterator.value().url.scheme() != QLatin1String("about") && !m_openUrls.contains(iterator.key()))
+			{
+				removedKeys.append(iterator.key());
+			}
+		}
+	}
+
+	for (int i = 0; i < removedKeys.count(); ++i)
+	{
+		removeEntry(removedKeys.at(i));
+	}
+
+	if (!m_filter.isEmpty())
+	{
+		updateMatches();
+	}
+}
+
+void AddressCompletionModel::addHistoryEntries(int request, const QList<HistoryRecord> &entries)
+{
+	if (request >= 0 && request == m_searchRequest)
+	{
+		const QString filter = m_filter.toLower();
+		const uint now = QDateTime::currentDateTime().toTime_t();
+
+		m_searchRequest = -1;
+
+		for (int i = 0; i < entries.count(); ++i)
+		{
+			const QString key = entries.at(i).url.toString();
+			const QString text = key.toLower();
+			int position = text.indexOf(filter);
+
+// inline completion needs text starting with filter, so only matches at word boundary of address are usable
+			while (position > 0 && text.at(position - 1).isLetterOrNumber())
+			{
+				position = text.indexOf(filter, (position + 1));
+			}
+
+			if (position < 0)
+			{
+				continue;
+			}
+
+			CompletionEntry entry;
+			entry.url = entries.at(i).url;
+			entry.time = entries.at(i).time.toTime_t();
+			entry.visits = entries.at(i).visits;
+			entry.isTyped = entries.at(i).typed;
+
+			CompletionMatch match;
+			match.text = key.mid(position);
+			match.url = entry.url;
+			match.score = getScore(entry, now);
+
+			m_searchMatches.append(match);
+		}
+
+		updateMatches();
+
+		return;
+	}
+
+	if (request < 0 || request != m_historyRequest)
+	{
+		return;
+	}
+
+	m_historyRequest = -1;
+
+	rebuildIndex(entries);
+}
+
+void AddressCompletionModel::addHistoryEntry(qint64 entry)
+{
+	if (!SettingsManager::getValue(QLatin1String("AddressField/SuggestHistory")).toBool())
+	{
+		return;
+	}
+
+	const HistoryEntry historyEntry = HistoryManager::getEntry(entry);
+
+	if (historyEntry.identifier < 0 || historyEntry.url.isEmpty())
+	{
+		return;
+	}
+
+	const QString key = historyEntry.url.toString();
+
+	m_historyEntries[entry] = key;
+
+	if (m_entries.contains(key))
+	{
+		CompletionEntry &completionEntry = m_entries[key];
+		completionEntry.time = historyEntry.time.toTime_t();
+		completionEntry.visits = qMax((completionEntry.visits + 1), historyEntry.visits);
+		completionEntry.isTyped = (completionEntry.isTyped || historyEntry.typed);
+	}
+	else
+	{
+		addEntry(historyEntry.url, historyEntry.time.toTime_t(), qMax(1, historyEntry.visits), false, historyEntry.typed);
+	}
+}
+
+void AddressCompletionModel::removeHistoryEntry(qint64 entry)
+{
+// only visits known to index can be accounted for, others are dropped by next rebuild
+	const QString key = m_historyEntries.take(entry);
+
+	if (key.isEmpty() || !m_entries.contains(key))
+	{
+		return;
+	}
+
+	CompletionEntry &completionEntry = m_entries[key];
+	--completionEntry.visits;
+
+	if (completionEntry.visits <= 0 && !completionEntry.isBookmark && !m_openUrls.contains(key))
+	{
+		removeEntry(key);
+	}
+
+	if (!m_filter.isEmpty())
+	{
+		updateMatches();
+	}
+}
+
+void AddressCompletionModel::addEntry(const QUrl &url, uint time, int visits, bool isBookmark, bool isTyped)
+{
+	const QString key = url.toString();
+
+	if (key.isEmpty())
+	{
+		return;
+	}
+
+	if (m_entries.contains(key))
+	{
+		CompletionEntry &entry = m_entries[key];
+		entry.time = qMax(entry.time, time);
+		entry.visits = qMax(entry.visits, visits);
+		entry.isBookmark = (entry.isBookmark || isBookmark);
+		entry.isTyped = (entry.isTyped || isTyped);
+
+		return;
+	}
+
+	CompletionEntry entry;
+	entry.url = url;
+	entry.time = time;
+	entry.visits = visits;
+	entry.isBookmark = isBookmark;
+	entry.isTyped = isTyped;
+
+	m_entries[key] = entry;
+
+	const QStringList indexKeys = getIndexKeys(key);
+
+	for (int i = 0; i < indexKeys.count(); ++i)
+	{
+		m_index.insertMulti(indexKeys.at(i), key);
+	}
+}
+
+void AddressCompletionModel::removeEntry(const QString &key)
+{
+	const QStringList indexKeys = getIndexKeys(key);
+
+	for (int i = 0; i < indexKeys.count(); ++i)
+	{
+		m_index.remove(indexKeys.at(i), key);
+	}
+
+	m_entries.remove(key);
+}
+
+void AddressCompletionModel::updateOpenUrls()
+{
+	m_openUrls.clear();
+
+	const QList<MainWindow*> windows = SessionsManager::getWindows();
+
+	for (int i = 0; i < windows.count(); ++i)
+	{
+		WindowsManager *manager = windows.at(i)->getWindowsManager();
+
+		for (int j = 0; j < manager->getWindowCount(); ++j)
+		{
+			Window *window = manager->getWindowByIndex(j);
+
+			if (window && !window->getUrl().isEmpty())
+			{
+				m_openUrls.insert(window->getUrl().toString());
+
+				addEntry(window->getUrl());
+			}
+		}
+	}
+}
+
+void AddressCompletionModel::updateMatches()
+{
+	QList<CompletionMatch> matches;
+
+	if (!m_filter.isEmpty())
+	{
+		const QString prefix = m_filter.toLower();
+		const uint now = QDateTime::currentDateTime().toTime_t();
+		QSet<QString> keys;
+		QMultiMap<QString, QString>::const_iterator iterator;
+
+		for (iterator = m_index.lowerBound(prefix); iterator != m_index.constEnd() && iterator.key().startsWith(prefix); ++iterator)
+		{
+			if (keys.contains(iterator.value()))
+			{
+				continue;
+			}
+
+			keys.insert(iterator.value());
+
+			const CompletionEntry &entry = m_entries[iterator.value()];
+			CompletionMatch match;
+			match.text = iterator.value().right(iterator.key().length());
+			match.url = entry.url;
+			match.score = getScore(entry, now);
+
+			matches.append(match);
+		}
+
+		for (int i = 0; i < m_searchMatches.count(); ++i)
+		{
+			const QString key = m_searchMatches.at(i).url.toString();
+
+			if (!keys.contains(key))
+			{
+				keys.insert(key);
+
+				matches.append(m_searchMatches.at(i));
+			}
+		}
+
+		qSort(matches.begin(), matches.end(), compareMatches);
+
+		if (matches.count() > 20)
+		{
+			matches = matches.mid(0, 20);
+		}
+	}
+
+// rows are updated in place instead of resetting model, so completer does not rebuild its state on each keystroke
+	const int previousCount = m_matches.count();
+
+	if (matches.count() < previousCount)
+	{
+		beginRemoveRows(QModelIndex(), matches.count(), (previousCount - 1));
+
+		m_matches = matches;
+
+		endRemoveRows();
+	}
+	else if (matches.count() > previousCount)
+	{
+		beginInsertRows(QModelIndex(), previousCount, (matches.count() - 1));
+
+		m_matches = matches;
+
+		endInsertRows();
+	}
+	else
+	{
+		m_matches = matches;
+	}
+
+	const int changedCount = qMin(previousCount, matches.count());
+
+	if (changedCount > 0)
+	{
+		emit dataChanged(index(0, 0), index((changedCount - 1), 0));
+	}
+}
+
+void AddressCompletionModel::setFilter(const QString &filter)
+{
+	if (filter == m_filter)
+	{
+		return;
+	}
+
+// open windows change too often to be tracked, so they are collected once when typing starts
+	if (m_filter.isEmpty())
+	{
+		updateOpenUrls();
+	}
+
+	m_filter = filter;
+
+// full text index of history finds addresses containing filter as word anywhere, they are merged when they arrive
+	m_searchMatches.clear();
+	m_searchRequest = ((!m_filter.isEmpty() && SettingsManager::getValue(QLatin1String("AddressField/SuggestHistory")).toBool()) ? HistoryManager::searchEntries(m_filter, 50, true) : -1);
+
+	updateMatches();
+}
+
 AddressCompletionModel* AddressCompletionModel::getInstance()
 {
 	if (!m_instance)
@@ -85,9 +465,17 @@ AddressCompletionModel* AddressCompletionModel::getInstance()
 
 QVariant AddressCompletionModel::data(const QModelIndex &index, int role) const
 {
-	if (role == Qt::DisplayRole && index.column() == 0 && index.row() >= 0 && index.row() < m_urls.count())
+	if (index.column() == 0 && index.row() >= 0 && index.row() < m_matches.count())
 	{
-		return m_urls.at(index.row());
+		if (role == Qt::DisplayRole)
+		{
+			return m_matches.at(index.row()).text;
+		}
+
+		if (role == Qt::UserRole)
+		{
+			return m_matches.at(index.row()).url;
+		}
 	}
 
 	return QVariant();
@@ -104,7 +492,87 @@ QVariant AddressCompletionModel::headerData(int section, Qt::Orientation orienta
 
 int AddressCompletionModel::rowCount(const QModelIndex &index) const
 {
-	return (index.isValid() ? 0 : m_urls.count());
+	return (index.isValid() ? 0 : m_matches.count());
+}
+
+int AddressCompletionModel::getScore(const CompletionEntry &entry, uint now) const
+{
+// frecency, visits weighted by age of last visit, typed addresses count double
+	int weight = 10;
+
+	if (entry.time > 0 && entry.time <= now)
+	{
+		const uint days = ((now - entry.time) / 86400);
+
+		if (days <= 4)
+		{
+			weight = 100;
+		}
+		else if (days <= 14)
+		{
+			weight = 70;
+		}
+		else if (days <= 31)
+		{
+			weight = 50;
+		}
+		else if (days <= 90)
+		{
+			weight = 30;
+		}
+	}
+
+	int score = (entry.visits * weight * (entry.isTyped ? 2 : 1));
+
+	if (entry.isBookmark)
+	{
+		score += 150;
+	}
+
+	if (m_openUrls.contains(entry.url.toString()))
+	{
+		score += 100;
+	}
+
+	return (score + 1);
+}
+
+QStringList AddressCompletionModel::getIndexKeys(const QString &key)
+{
+// address is indexed also without scheme and leading "www." so typing host alone finds it, every indexed form is a suffix of address
+	QStringList keys;
+	QString text = key.toLower();
+
+	keys.append(text);
+
+	const int position = text.indexOf(QLatin1String("://"));
+
+	if (position > 0)
+	{
+		text = text.mid(position + 3);
+
+		if (!text.isEmpty())
+		{
+			keys.append(text);
+		}
+	}
+
+	if (text.startsWith(QLatin1String("www.")) && text.length() > 4)
+	{
+		keys.append(text.mid(4));
+	}
+
+	return keys;
+}
+
+bool AddressCompletionModel::compareMatches(const CompletionMatch &first, const CompletionMatch &second)
+{
+	if (first.score != second.score)
+	{
+		return (first.score > second.score);
+	}
+
+	return (first.text.length() < second.text.length());
 }
 
 }
@@ -20,7 +20,11 @@
 #ifndef OTTER_ADDRESSCOMPLETIONMODEL_H
 #define OTTER_ADDRESSCOMPLETIONMODEL_H
 
+#include "HistoryDatabase.h"
+
 #include <QtCore/QAbstractListModel>
+#include <QtCore/QMap>
+#include <QtCore/QSet>
 #include <QtCore/QUrl>
 
 namespace Otter
@@ -32,21 +36,62 @@ class AddressCompletionModel : public QAbstractListModel
 
 public:
 	static AddressCompletionModel* getInstance();
+	void setFilter(const QString &filter);
 	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 	int rowCount(const QModelIndex &index = QModelIndex()) const;
 
 protected:
+	struct CompletionEntry
+	{
+		QUrl url;
+		uint time;
+		int visits;
+		bool isBookmark;
+		bool isTyped;
+
+		CompletionEntry() : time(0), visits(0), isBookmark(false), isTyped(false) {}
+	};
+
+	struct CompletionMatch
+	{
+		QString text;
+		QUrl url;
+		int score;
+
+		CompletionMatch() : score(0) {}
+	};
+
 	explicit AddressCompletionModel(QObject *parent = NULL);
 
 	void timerEvent(QTimerEvent *event);
+	void addEntry(const QUrl &url, uint time = 0, int visits = 0, bool isBookmark = false, bool isTyped = false);
+	void removeEntry(const QString &key);
+	void rebuildIndex(const QList<HistoryRecord> &entries);
+	void updateOpenUrls();
+	void updateMatches();
+	int getScore(const CompletionEntry &entry, uint now) const;
+	static QStringList getIndexKeys(const QString &key);
+	static bool compareMatches(const CompletionMatch &first, const CompletionMatch &second);
 
 protected slots:
 	void optionChanged(const QString &option);
 	void updateCompletion();
+	void updateBookmarks();
+	void addHistoryEntries(int request, const QList<HistoryRecord> &entries);
+	void addHistoryEntry(qint64 entry);
+	void removeHistoryEntry(qint64 entry);
 
 private:
-	QList<QUrl> m_urls;
+	QHash<QString, CompletionEntry> m_entries;
+	QHash<qint64, QString> m_historyEntries;
+	QMultiMap<QString, QString> m_index;
+	QSet<QString> m_openUrls;
+	QList<CompletionMatch> m_matches;
+	QList<CompletionMatch> m_searchMatches;
+	QString m_filter;
+	int m_historyRequest;
+	int m_searchRequest;
 	int m_updateTimer;
 
 	static AddressCompletionModel *m_instance;
@@ -25,12 +25,37 @@
 #include "SessionsManager.h"
 
 #include <QtCore/QDir>
+#include <QtCore/QMutexLocker>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+
+#if QT_VERSION < 0x050600
+uint qHash(const QVector<int> &key, uint seed = 0)
+{
+	for (int i = 0; i < key.count(); ++i)
+	{
+		seed = ((seed * 31) + qHash(key.at(i)));
+	}
+
+	return seed;
+}
+#endif
 
 namespace Otter
 {
 
 ContentBlockingManager* ContentBlockingManager::m_instance = NULL;
 QVector<ContentBlockingProfile*> ContentBlockingManager::m_profiles;
+QHash<QVector<int>, QSharedPointer<const ContentBlockingManager::ContentBlockingIndex> > ContentBlockingManager::m_indexes;
+QHash<QVector<int>, quint64> ContentBlockingManager::m_outdatedIndexes;
+QHash<QVector<int>, int> ContentBlockingManager::m_profilesUsers;
+QSet<QVector<int> > ContentBlockingManager::m_pendingIndexes;
+QCache<ContentBlockingManager::ContentBlockingDecision, bool> ContentBlockingManager::m_decisions(1000);
+QMutex ContentBlockingManager::m_mutex;
+quint64 ContentBlockingManager::m_decisionHits = 0;
+quint64 ContentBlockingManager::m_decisionMisses = 0;
+quint64 ContentBlockingManager::m_generation = 0;
 
 ContentBlockingManager::ContentBlockingManager(QObject *parent) : QObject(parent)
 {
@@ -46,6 +71,42 @@ void ContentBlockingManager::createInstance(QObject *parent)
 	}
 }
 
+void ContentBlockingManager::registerProfiles(const QVector<int> &profiles)
+{
+	if (profiles.isEmpty())
+	{
+		return;
+	}
+
+	QMutexLocker locker(&m_mutex);
+
+	++m_profilesUsers[profiles];
+}
+
+void ContentBlockingManager::unregisterProfiles(const QVector<int> &profiles)
+{
+	if (profiles.isEmpty())
+	{
+		return;
+	}
+
+	QMutexLocker locker(&m_mutex);
+
+	if (!m_profilesUsers.contains(profiles))
+	{
+		return;
+	}
+
+	--m_profilesUsers[profiles];
+
+	if (m_profilesUsers.value(profiles) <= 0)
+	{
+		m_profilesUsers.remove(profiles);
+
+		removeUnusedIndexes(QVector<int>());
+	}
+}
+
 void ContentBlockingManager::loadProfiles()
 {
 	const QString contentBlockingPath = SessionsManager::getWritableDataPath(QLatin1String("blocking"));
@@ -73,16 +134,168 @@ void ContentBlockingManager::loadProfiles()
 
 	for (int i = 0; i < existingProfiles.count(); ++i)
 	{
-		m_profiles.append(new ContentBlockingProfile(existingProfiles.at(i).absoluteFilePath(), m_instance));
+		ContentBlockingProfile *profile = new ContentBlockingProfile(existingProfiles.at(i).absoluteFilePath(), m_instance);
+
+		m_profiles.append(profile);
+
+		connect(profile, SIGNAL(profileModified(QString)), m_instance, SLOT(handleProfileModified(QString)));
+	}
+}
+
+void ContentBlockingManager::handleProfileModified(const QString &profile)
+{
+	QMutexLocker locker(&m_mutex);
+
+	++m_generation;
+
+	m_decisions.clear();
+
+// affected indexes are still used until their replacements are compiled
+	const QList<QVector<int> > indexes = (m_indexes.keys() + m_pendingIndexes.toList());
+
+	for (int i = 0; i < indexes.count(); ++i)
+	{
+		for (int j = 0; j < indexes.at(i).count(); ++j)
+		{
+			if (m_profiles.at(indexes.at(i).at(j))->getInformation().name == profile)
+			{
+				m_outdatedIndexes[indexes.at(i)] = m_generation;
+
+				break;
+			}
+		}
+	}
+}
+
+void ContentBlockingManager::buildIndex(const QVector<int> &profiles, const QVector<QSharedPointer<const ContentBlockingProfile::RuleSet> > &ruleSets, quint64 generation)
+{
+	QSharedPointer<ContentBlockingIndex> index(new ContentBlockingIndex());
+	int offset = 0;
+
+	for (int i = 0; i < ruleSets.count(); ++i)
+	{
+		const QVector<ContentBlockingProfile::ContentBlockingRule> &rules = ruleSets.at(i)->rules;
+
+		for (int j = 0; j < rules.count(); ++j)
+		{
+			const ContentBlockingProfile::ContentBlockingRule &rule = rules.at(j);
+			const QString domainKey = ContentBlockingProfile::getDomainRuleKey(rule);
+
+			if (!domainKey.isEmpty())
+			{
+				index->domainRules.insert(domainKey, (offset + j));
+
+				continue;
+			}
+
+			index->matcher.addPattern(rule.pattern.mid(rule.keyPosition, rule.keyLength), (offset + j));
+
+			if (rule.isException)
+			{
+				index->exceptionsMatcher.addPattern(rule.pattern.mid(rule.keyPosition, rule.keyLength), (offset + j));
+			}
+		}
+
+		index->ruleSets.append(ruleSets.at(i));
+		index->offsets.append(offset);
+
+		offset += rules.count();
+	}
+
+	index->matcher.compile();
+	index->exceptionsMatcher.compile();
+
+	QMutexLocker locker(&m_mutex);
+
+	m_indexes[profiles] = index;
+	m_pendingIndexes.remove(profiles);
+
+	removeUnusedIndexes(profiles);
+
+// index built from rules which were modified in the meantime replaces previous one, but it will be compiled again
+	if (m_outdatedIndexes.contains(profiles) && m_outdatedIndexes.value(profiles) <= generation)
+	{
+		m_outdatedIndexes.remove(profiles);
+	}
+
+// decisions could be made using previous index
+	++m_generation;
+
+	m_decisions.clear();
+}
+
+void ContentBlockingManager::removeUnusedIndexes(const QVector<int> &keptProfiles)
+{
+// index is kept while some window uses its profiles, or their part which is ready while remaining ones are still loading
+	const QList<QVector<int> > indexes = m_indexes.keys();
+
+	for (int i = 0; i < indexes.count(); ++i)
+	{
+		const QVector<int> &profiles = indexes.at(i);
+
+		if (profiles == keptProfiles)
+		{
+			continue;
+		}
+
+		bool isUsed = false;
+		QHash<QVector<int>, int>::const_iterator iterator;
+
+		for (iterator = m_profilesUsers.constBegin(); iterator != m_profilesUsers.constEnd(); ++iterator)
+		{
+			if (std::includes(iterator.key().constBegin(), iterator.key().constEnd(), profiles.constBegin(), profiles.constEnd()))
+			{
+				isUsed = true;
+
+				break;
+			}
+		}
+
+		if (!isUsed)
+		{
+			m_indexes.remove(profiles);
+			m_outdatedIndexes.remove(profiles);
+		}
 	}
 }
 
+QSharedPointer<const ContentBlockingManager::ContentBlockingIndex> ContentBlockingManager::getIndex(const QVector<int> &profiles)
+{
+	QMutexLocker locker(&m_mutex);
+
+	const QSharedPointer<const ContentBlockingIndex> index = m_indexes.value(profiles);
+
+	if ((index && !m_outdatedIndexes.contains(profiles)) || m_pendingIndexes.contains(profiles))
+	{
+		return index;
+	}
+
+	m_pendingIndexes.insert(profiles);
+
+	const quint64 generation = m_generation;
+
+	locker.unlock();
+
+	QVector<QSharedPointer<const ContentBlockingProfile::RuleSet> > ruleSets;
+	ruleSets.reserve(profiles.count());
+
+	for (int i = 0; i < profiles.count(); ++i)
+	{
+		ruleSets.append(m_profiles.at(profiles[i])->getRuleSet());
+	}
+
+// merged automaton is compiled in background, until it is ready previous one (if any) is used
+	QtConcurrent::run(&ContentBlockingManager::buildIndex, profiles, ruleSets, generation);
+
+	return index;
+}
+
 ContentBlockingManager* ContentBlockingManager::getInstance()
 {
 	return m_instance;
 }
 
-QByteArray ContentBlockingManager::getStyleSheet(const QVector<int> &profiles)
+QByteArray ContentBlockingManager::getStyleSheet(const QVector<int> &profiles, const QString &host)
 {
 	QByteArray styleSheet;
 
@@ -90,7 +303,7 @@ QByteArray ContentBlockingManager::getStyleSheet(const QVector<int> &profiles)
 	{
 		if (profiles[i] >= 0 && profiles[i] < m_profiles.count())
 		{
-			styleSheet += m_profiles.at(profiles[i])->getStyleSheet();
+			styleSheet += m_profiles.at(profiles[i])->getStyleSheet(host).toUtf8();
 		}
 	}
 
@@ -128,34 +341,16 @@ QVector<ContentBlockingInformation> ContentBlockingManager::getProfiles()
 	return profiles;
 }
 
-QMultiHash<QString, QString> ContentBlockingManager::getStyleSheetBlackList(const QVector<int> &profiles)
+int ContentBlockingManager::getIndexProfile(const ContentBlockingIndex *index, int identifier)
 {
-	QMultiHash<QString, QString> blackList;
+	int profile = (index->offsets.count() - 1);
 
-	for (int i = 0; i < profiles.count(); ++i)
+	while (identifier < index->offsets.at(profile))
 	{
-		if (profiles[i] >= 0 && profiles[i] < m_profiles.count())
-		{
-			blackList += m_profiles.at(profiles[i])->getStyleSheetWhiteList();
-		}
-	}
-
-	return blackList;
-}
-
-QMultiHash<QString, QString> ContentBlockingManager::getStyleSheetWhiteList(const QVector<int> &profiles)
-{
-	QMultiHash<QString, QString> whiteList;
-
-	for (int i = 0; i < profiles.count(); ++i)
-	{
-		if (profiles[i] >= 0 && profiles[i] < m_profiles.count())
-		{
-			whiteList += m_profiles.at(profiles[i])->getStyleSheetBlackList();
-		}
+		--profile;
 	}
 
-	return whiteList;
+	return profile;
 }
 
 QVector<int> ContentBlockingManager::getProfileList(const QStringList &names)
@@ -174,6 +369,20 @@ QVector<int> ContentBlockingManager::getProfileList(const QStringList &names)
 	return profiles;
 }
 
+quint64 ContentBlockingManager::getDecisionCacheHits()
+{
+	QMutexLocker locker(&m_mutex);
+
+	return m_decisionHits;
+}
+
+quint64 ContentBlockingManager::getDecisionCacheMisses()
+{
+	QMutexLocker locker(&m_mutex);
+
+	return m_decisionMisses;
+}
+
 bool ContentBlockingManager::isUrlBlocked(const QVector<int> &profiles, const QNetworkRequest &request, const QUrl &baseUrl)
 {
 	if (profiles.isEmpty())
@@ -188,11 +397,174 @@ bool ContentBlockingManager::isUrlBlocked(const QVector<int> &profiles, const QN
 		return false;
 	}
 
+	ContentBlockingDecision decision;
+	decision.profiles = profiles;
+	decision.baseHost = baseUrl.host();
+	decision.url = request.url().url();
+	decision.resourceType = static_cast<int>(ContentBlockingProfile::getResourceType(request, decision.url));
+	decision.hash = (qHash(decision.url) ^ qHash(decision.baseHost) ^ qHash(profiles) ^ static_cast<uint>(decision.resourceType));
+
+	QMutexLocker locker(&m_mutex);
+	const bool *cachedDecision = m_decisions.object(decision);
+
+	if (cachedDecision)
+	{
+		++m_decisionHits;
+
+		return *cachedDecision;
+	}
+
+	++m_decisionMisses;
+
+	const quint64 generation = m_generation;
+
+	locker.unlock();
+
+	const bool isBlocked = checkUrl(profiles, request, baseUrl);
+
+	locker.relock();
+
+	if (generation == m_generation)
+	{
+		m_decisions.insert(decision, new bool(isBlocked));
+	}
+
+	return isBlocked;
+}
+
+bool ContentBlockingManager::checkUrl(const QVector<int> &profiles, const QNetworkRequest &request, const QUrl &baseUrl)
+{
+// invalid profiles and those which are still loading are skipped, so they do not disable remaining ones
+	QVector<int> readyProfiles;
+	readyProfiles.reserve(profiles.count());
+
 	for (int i = 0; i < profiles.count(); ++i)
 	{
-		if (profiles[i] >= 0 && profiles[i] < m_profiles.count() && m_profiles.at(profiles[i])->isUrlBlocked(request, baseUrl))
+		if (profiles[i] >= 0 && profiles[i] < m_profiles.count() && m_profiles.at(profiles[i])->isReady())
+		{
+			readyProfiles.append(profiles[i]);
+		}
+	}
+
+	if (readyProfiles.isEmpty())
+	{
+		return false;
+	}
+
+	if (readyProfiles.count() == 1)
+	{
+		return m_profiles.at(readyProfiles[0])->isUrlBlocked(request, baseUrl);
+	}
+
+	const QSharedPointer<const ContentBlockingIndex> index = getIndex(readyProfiles);
+
+	if (!index)
+	{
+		for (int i = 0; i < readyProfiles.count(); ++i)
+		{
+			if (m_profiles.at(readyProfiles[i])->isUrlBlocked(request, baseUrl))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	const QString url = request.url().url();
+	ContentBlockingProfile::RequestInformation information;
+	QVector<bool> blockedProfiles(readyProfiles.count(), false);
+	QVector<bool> allowedProfiles(readyProfiles.count(), false);
+	bool hasInformation = false;
+	bool isBlocked = false;
+
+	if (!index->domainRules.isEmpty())
+	{
+		const QString reversedHost = ContentBlockingProfile::getReversedHost(request.url().host());
+
+		for (int i = 1; i <= reversedHost.length(); ++i)
+		{
+			if (i < reversedHost.length() && reversedHost.at(i) != QLatin1Char('.'))
+			{
+				continue;
+			}
+
+			const QString domain = reversedHost.left(i);
+			QMultiHash<QString, int>::const_iterator iterator = index->domainRules.constFind(domain);
+
+			while (iterator != index->domainRules.constEnd() && iterator.key() == domain)
+			{
+				const int profile = getIndexProfile(index.data(), iterator.value());
+				const ContentBlockingProfile::ContentBlockingRule &rule = index->ruleSets.at(profile)->rules.at(iterator.value() - index->offsets.at(profile));
+
+				if (!hasInformation)
+				{
+					information = ContentBlockingProfile::getRequestInformation(request, url, baseUrl);
+					hasInformation = true;
+				}
+
+				if (ContentBlockingProfile::checkRuleOptions(rule, information.options, information.baseHost))
+				{
+					if (rule.isException)
+					{
+						allowedProfiles[profile] = true;
+					}
+					else
+					{
+						blockedProfiles[profile] = true;
+					}
+				}
+
+				++iterator;
+			}
+		}
+	}
+
+	for (int i = 0; i < readyProfiles.count(); ++i)
+	{
+		if (blockedProfiles.at(i) && !allowedProfiles.at(i))
+		{
+			isBlocked = true;
+
+			break;
+		}
+	}
+
+// if some profile already blocks request, only its exception rules can change that
+	for (int i = (isBlocked ? 0 : 1); i < 2; ++i)
+	{
+		const QVector<ContentBlockingMatcher::Match> matches = ((i == 0) ? index->exceptionsMatcher : index->matcher).match(url);
+
+		if (!matches.isEmpty() && !hasInformation)
+		{
+			information = ContentBlockingProfile::getRequestInformation(request, url, baseUrl);
+			hasInformation = true;
+		}
+
+		for (int j = 0; j < matches.count(); ++j)
+		{
+			const int profile = getIndexProfile(index.data(), matches.at(j).identifier);
+			const ContentBlockingProfile::ContentBlockingRule &rule = index->ruleSets.at(profile)->rules.at(matches.at(j).identifier - index->offsets.at(profile));
+
+			if (!allowedProfiles.at(profile) && ContentBlockingProfile::checkRuleMatch(rule, information, matches.at(j).position))
+			{
+				if (rule.isException)
+				{
+					allowedProfiles[profile] = true;
+				}
+				else
+				{
+					blockedProfiles[profile] = true;
+				}
+			}
+		}
+
+		for (int j = 0; j < readyProfiles.count(); ++j)
 		{
-			return true;
+			if (blockedProfiles.at(j) && !allowedProfiles.at(j))
+			{
+				return true;
+			}
 		}
 	}
 
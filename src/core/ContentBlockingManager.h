@@ -21,38 +21,89 @@
 #ifndef OTTER_CONTENTBLOCKINGMANAGER_H
 #define OTTER_CONTENTBLOCKINGMANAGER_H
 
+#include "ContentBlockingMatcher.h"
+#include "ContentBlockingProfile.h"
+
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QSharedPointer>
 #include <QtNetwork/QNetworkRequest>
 
 namespace Otter
 {
 
-class ContentBlockingProfile;
-struct ContentBlockingInformation;
-
 class ContentBlockingManager : public QObject
 {
 	Q_OBJECT
 
 public:
 	static void createInstance(QObject *parent = NULL);
+	static void registerProfiles(const QVector<int> &profiles);
+	static void unregisterProfiles(const QVector<int> &profiles);
 	static ContentBlockingManager* getInstance();
-	static QByteArray getStyleSheet(const QVector<int> &profiles);
+	static QByteArray getStyleSheet(const QVector<int> &profiles, const QString &host = QString());
 	static QStringList createSubdomainList(const QString &domain);
 	static QVector<ContentBlockingInformation> getProfiles();
-	static QMultiHash<QString, QString> getStyleSheetBlackList(const QVector<int> &profiles);
-	static QMultiHash<QString, QString> getStyleSheetWhiteList(const QVector<int> &profiles);
 	static QVector<int> getProfileList(const QStringList &names);
+	static quint64 getDecisionCacheHits();
+	static quint64 getDecisionCacheMisses();
 	static bool isUrlBlocked(const QVector<int> &profiles, const QNetworkRequest &request, const QUrl &baseUrl);
 
 protected:
+	struct ContentBlockingDecision
+	{
+		QVector<int> profiles;
+		QString baseHost;
+		QString url;
+		int resourceType;
+		uint hash;
+
+		bool operator==(const ContentBlockingDecision &other) const
+		{
+			return (hash == other.hash && resourceType == other.resourceType && url == other.url && baseHost == other.baseHost && profiles == other.profiles);
+		}
+
+		friend uint qHash(const ContentBlockingDecision &key, uint seed = 0)
+		{
+			return (key.hash ^ seed);
+		}
+	};
+
+	struct ContentBlockingIndex
+	{
+		ContentBlockingMatcher matcher;
+		ContentBlockingMatcher exceptionsMatcher;
+		QVector<QSharedPointer<const ContentBlockingProfile::RuleSet> > ruleSets;
+		QMultiHash<QString, int> domainRules;
+		QVector<int> offsets;
+	};
+
 	explicit ContentBlockingManager(QObject *parent = NULL);
 
 	static void loadProfiles();
+	static void buildIndex(const QVector<int> &profiles, const QVector<QSharedPointer<const ContentBlockingProfile::RuleSet> > &ruleSets, quint64 generation);
+	static void removeUnusedIndexes(const QVector<int> &keptProfiles);
+	static QSharedPointer<const ContentBlockingIndex> getIndex(const QVector<int> &profiles);
+	static int getIndexProfile(const ContentBlockingIndex *index, int identifier);
+	static bool checkUrl(const QVector<int> &profiles, const QNetworkRequest &request, const QUrl &baseUrl);
+
+protected slots:
+	void handleProfileModified(const QString &profile);
 
 private:
 	static ContentBlockingManager *m_instance;
 	static QVector<ContentBlockingProfile*> m_profiles;
+	static QHash<QVector<int>, QSharedPointer<const ContentBlockingIndex> > m_indexes;
+	static QHash<QVector<int>, quint64> m_outdatedIndexes;
+	static QHash<QVector<int>, int> m_profilesUsers;
+	static QSet<QVector<int> > m_pendingIndexes;
+	static QCache<ContentBlockingDecision, bool> m_decisions;
+	static QMutex m_mutex;
+	static quint64 m_decisionHits;
+	static quint64 m_decisionMisses;
+	static quint64 m_generation;
 };
 
 }
@@ -0,0 +1,456 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "ContentBlockingMatcher.h"
+
+#include <algorithm>
+
+namespace Otter
+{
+
+ContentBlockingMatcher::ContentBlockingMatcher() :
+	m_edgeOffsets(NULL),
+	m_edgeTargets(NULL),
+	m_failureLinks(NULL),
+	m_outputLinks(NULL),
+	m_outputOffsets(NULL),
+	m_outputIdentifiers(NULL),
+	m_depths(NULL),
+	m_rootTransitions(NULL),
+	m_edgeCharacters(NULL),
+	m_nodesAmount(0),
+	m_outputsAmount(0)
+{
+}
+
+void ContentBlockingMatcher::addPattern(const QString &pattern, int identifier)
+{
+	if (!pattern.isEmpty())
+	{
+		m_patterns.append(qMakePair(pattern, identifier));
+	}
+}
+
+void ContentBlockingMatcher::compile()
+{
+	std::sort(m_patterns.begin(), m_patterns.end());
+
+// patterns are sorted, so trie can be built by reusing common prefix of previous pattern, without looking up children
+	QVector<int> depths;
+	QVector<int> edgeParents;
+	QVector<ushort> edgeCharacters;
+	QVector<int> edgeChildren;
+	QVector<int> terminalNodes;
+	QVector<int> path;
+	QString previousPattern;
+
+	terminalNodes.reserve(m_patterns.count());
+	path.append(0);
+
+	depths.append(0);
+
+	for (int i = 0; i < m_patterns.count(); ++i)
+	{
+		const QString pattern = m_patterns.at(i).first;
+		const int limit = qMin(pattern.length(), previousPattern.length());
+		int commonLength = 0;
+
+		while (commonLength < limit && pattern.at(commonLength) == previousPattern.at(commonLength))
+		{
+			++commonLength;
+		}
+
+		path.resize(commonLength + 1);
+
+		for (int j = commonLength; j < pattern.length(); ++j)
+		{
+			const int node = depths.count();
+
+			depths.append(j + 1);
+
+			edgeParents.append(path.last());
+			edgeCharacters.append(pattern.at(j).unicode());
+			edgeChildren.append(node);
+
+			path.append(node);
+		}
+
+		terminalNodes.append(path.last());
+
+		previousPattern = pattern;
+	}
+
+	const int nodesAmount = depths.count();
+	const int edgesAmount = edgeParents.count();
+	const int outputsAmount = terminalNodes.count();
+
+	m_data = QByteArray(((4 + (nodesAmount + 1) + edgesAmount + nodesAmount + nodesAmount + (nodesAmount + 1) + outputsAmount + nodesAmount + 128) * sizeof(qint32)) + (edgesAmount * sizeof(quint16)), 0);
+
+	qint32 *header = reinterpret_cast<qint32*>(m_data.data());
+	header[0] = 0x4f41434d;
+	header[1] = nodesAmount;
+	header[2] = edgesAmount;
+	header[3] = outputsAmount;
+
+	mapData();
+
+// pointers are read only for matching, compilation fills them in place
+	qint32 *edgeOffsets = const_cast<qint32*>(m_edgeOffsets);
+	qint32 *edgeTargets = const_cast<qint32*>(m_edgeTargets);
+	qint32 *failureLinks = const_cast<qint32*>(m_failureLinks);
+	qint32 *outputLinks = const_cast<qint32*>(m_outputLinks);
+	qint32 *outputOffsets = const_cast<qint32*>(m_outputOffsets);
+	qint32 *outputIdentifiers = const_cast<qint32*>(m_outputIdentifiers);
+	qint32 *nodeDepths = const_cast<qint32*>(m_depths);
+	qint32 *rootTransitions = const_cast<qint32*>(m_rootTransitions);
+	quint16 *characters = const_cast<quint16*>(m_edgeCharacters);
+
+	for (int i = 0; i < edgesAmount; ++i)
+	{
+		++edgeOffsets[edgeParents.at(i) + 1];
+	}
+
+	for (int i = 0; i < nodesAmount; ++i)
+	{
+		edgeOffsets[i + 1] += edgeOffsets[i];
+		nodeDepths[i] = depths.at(i);
+	}
+
+	QVector<int> edgePositions(nodesAmount);
+
+	for (int i = 0; i < nodesAmount; ++i)
+	{
+		edgePositions[i] = edgeOffsets[i];
+	}
+
+	for (int i = 0; i < edgesAmount; ++i)
+	{
+		const int position = edgePositions[edgeParents.at(i)]++;
+
+		characters[position] = edgeCharacters.at(i);
+		edgeTargets[position] = edgeChildren.at(i);
+	}
+
+	for (int i = 0; i < outputsAmount; ++i)
+	{
+		++outputOffsets[terminalNodes.at(i) + 1];
+	}
+
+	for (int i = 0; i < nodesAmount; ++i)
+	{
+		outputOffsets[i + 1] += outputOffsets[i];
+	}
+
+	QVector<int> outputPositions(nodesAmount);
+
+	for (int i = 0; i < nodesAmount; ++i)
+	{
+		outputPositions[i] = outputOffsets[i];
+	}
+
+	for (int i = 0; i < outputsAmount; ++i)
+	{
+		outputIdentifiers[outputPositions[terminalNodes.at(i)]++] = m_patterns.at(i).second;
+	}
+
+	for (int i = 0; i < 128; ++i)
+	{
+		rootTransitions[i] = -1;
+	}
+
+	for (int i = edgeOffsets[0]; i < edgeOffsets[1]; ++i)
+	{
+		if (characters[i] < 128)
+		{
+			rootTransitions[characters[i]] = edgeTargets[i];
+		}
+	}
+
+	QVector<int> queue;
+	queue.reserve(nodesAmount);
+
+	for (int i = edgeOffsets[0]; i < edgeOffsets[1]; ++i)
+	{
+		queue.append(edgeTargets[i]);
+	}
+
+	for (int i = 0; i < queue.count(); ++i)
+	{
+		const int node = queue.at(i);
+
+		for (int j = edgeOffsets[node]; j < edgeOffsets[node + 1]; ++j)
+		{
+			const int child = edgeTargets[j];
+			int failureLink = failureLinks[node];
+			int transition = findTransition(failureLink, characters[j]);
+
+			while (transition < 0 && failureLink != 0)
+			{
+				failureLink = failureLinks[failureLink];
+				transition = findTransition(failureLink, characters[j]);
+			}
+
+			failureLink = qMax(transition, 0);
+
+			failureLinks[child] = failureLink;
+			outputLinks[child] = ((outputOffsets[failureLink] < outputOffsets[failureLink + 1]) ? failureLink : outputLinks[failureLink]);
+
+			queue.append(child);
+		}
+	}
+
+	m_patterns.clear();
+	m_patterns.squeeze();
+}
+
+void ContentBlockingMatcher::clear()
+{
+	m_patterns.clear();
+	m_data.clear();
+
+	m_edgeOffsets = NULL;
+	m_edgeTargets = NULL;
+	m_failureLinks = NULL;
+	m_outputLinks = NULL;
+	m_outputOffsets = NULL;
+	m_outputIdentifiers = NULL;
+	m_depths = NULL;
+	m_rootTransitions = NULL;
+	m_edgeCharacters = NULL;
+	m_nodesAmount = 0;
+	m_outputsAmount = 0;
+}
+
+QByteArray ContentBlockingMatcher::getData() const
+{
+	return m_data;
+}
+
+QVector<ContentBlockingMatcher::Match> ContentBlockingMatcher::match(const QString &text) const
+{
+	QVector<Match> matches;
+
+	if (m_outputsAmount == 0)
+	{
+		return matches;
+	}
+
+	const QChar *data = text.constData();
+	const int length = text.length();
+	int node = 0;
+
+	for (int i = 0; i < length; ++i)
+	{
+		const ushort character = data[i].unicode();
+		int transition = findTransition(node, character);
+
+		while (transition < 0 && node != 0)
+		{
+			node = m_failureLinks[node];
+			transition = findTransition(node, character);
+		}
+
+		node = qMax(transition, 0);
+
+		int output = ((m_outputOffsets[node] < m_outputOffsets[node + 1]) ? node : m_outputLinks[node]);
+
+		while (output > 0)
+		{
+			const int position = (i - m_depths[output] + 1);
+
+			for (int j = m_outputOffsets[output]; j < m_outputOffsets[output + 1]; ++j)
+			{
+				Match match;
+				match.identifier = m_outputIdentifiers[j];
+				match.position = position;
+
+				matches.append(match);
+			}
+
+			output = m_outputLinks[output];
+		}
+	}
+
+	return matches;
+}
+
+int ContentBlockingMatcher::findTransition(int node, ushort character) const
+{
+	if (node == 0 && character < 128)
+	{
+		return m_rootTransitions[character];
+	}
+
+	int low = m_edgeOffsets[node];
+	int high = (m_edgeOffsets[node + 1] - 1);
+
+	while (low <= high)
+	{
+		const int middle = ((low + high) / 2);
+		const ushort value = m_edgeCharacters[middle];
+
+		if (value == character)
+		{
+			return m_edgeTargets[middle];
+		}
+
+		if (value < character)
+		{
+			low = (middle + 1);
+		}
+		else
+		{
+			high = (middle - 1);
+		}
+	}
+
+	return -1;
+}
+
+int ContentBlockingMatcher::getMaximumIdentifier() const
+{
+	int identifier = -1;
+
+	for (int i = 0; i < m_outputsAmount; ++i)
+	{
+		identifier = qMax(identifier, static_cast<int>(m_outputIdentifiers[i]));
+	}
+
+	return identifier;
+}
+
+int ContentBlockingMatcher::getNodesAmount() const
+{
+	return m_nodesAmount;
+}
+
+void ContentBlockingMatcher::mapData()
+{
+	const qint32 *header = reinterpret_cast<const qint32*>(m_data.constData());
+
+	m_nodesAmount = header[1];
+	m_outputsAmount = header[3];
+	m_edgeOffsets = (header + 4);
+	m_edgeTargets = (m_edgeOffsets + m_nodesAmount + 1);
+	m_failureLinks = (m_edgeTargets + header[2]);
+	m_outputLinks = (m_failureLinks + m_nodesAmount);
+	m_outputOffsets = (m_outputLinks + m_nodesAmount);
+	m_outputIdentifiers = (m_outputOffsets + m_nodesAmount + 1);
+	m_depths = (m_outputIdentifiers + m_outputsAmount);
+	m_rootTransitions = (m_depths + m_nodesAmount);
+	m_edgeCharacters = reinterpret_cast<const quint16*>(m_rootTransitions + 128);
+}
+
+bool ContentBlockingMatcher::setData(const QByteArray &data)
+{
+	if (data.size() < static_cast<int>(4 * sizeof(qint32)))
+	{
+		return false;
+	}
+
+	const qint32 *header = reinterpret_cast<const qint32*>(data.constData());
+	const qint32 nodesAmount = header[1];
+	const qint32 edgesAmount = header[2];
+	const qint32 outputsAmount = header[3];
+
+	if (header[0] != 0x4f41434d || nodesAmount < 1 || nodesAmount > (data.size() / 16) || edgesAmount != (nodesAmount - 1) || outputsAmount < 0 || outputsAmount > (data.size() / 4) || static_cast<qint64>(data.size()) != static_cast<qint64>(((4 + (nodesAmount + 1) + edgesAmount + nodesAmount + nodesAmount + (nodesAmount + 1) + outputsAmount + nodesAmount + 128) * sizeof(qint32)) + (edgesAmount * sizeof(quint16))))
+	{
+		return false;
+	}
+
+	m_data = data;
+
+	mapData();
+
+	if (!checkData())
+	{
+		clear();
+
+		return false;
+	}
+
+	return true;
+}
+
+bool ContentBlockingMatcher::checkData() const
+{
+// cache is read from disk, so every offset and link is verified before matching relies on it
+	if (m_edgeOffsets[0] != 0 || m_edgeOffsets[m_nodesAmount] != (m_nodesAmount - 1) || m_outputOffsets[0] != 0 || m_outputOffsets[m_nodesAmount] != m_outputsAmount || m_depths[0] != 0 || m_failureLinks[0] != 0 || m_outputLinks[0] != 0)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < m_nodesAmount; ++i)
+	{
+		if (m_edgeOffsets[i + 1] < m_edgeOffsets[i] || m_outputOffsets[i + 1] < m_outputOffsets[i])
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < m_nodesAmount; ++i)
+	{
+		for (int j = m_edgeOffsets[i]; j < m_edgeOffsets[i + 1]; ++j)
+		{
+			const int target = m_edgeTargets[j];
+
+			if (target < 1 || target >= m_nodesAmount || m_depths[target] != (m_depths[i] + 1) || (j > m_edgeOffsets[i] && m_edgeCharacters[j] <= m_edgeCharacters[j - 1]))
+			{
+				return false;
+			}
+		}
+
+// links have to lead to shallower nodes, otherwise matching would never leave them
+		if (i > 0)
+		{
+			const int failureLink = m_failureLinks[i];
+			const int outputLink = m_outputLinks[i];
+
+			if (m_depths[i] < 1 || failureLink < 0 || failureLink >= m_nodesAmount || m_depths[failureLink] >= m_depths[i] || outputLink < 0 || outputLink >= m_nodesAmount || (outputLink > 0 && m_depths[outputLink] >= m_depths[i]))
+			{
+				return false;
+			}
+		}
+	}
+
+	for (int i = 0; i < m_outputsAmount; ++i)
+	{
+		if (m_outputIdentifiers[i] < 0)
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < 128; ++i)
+	{
+		if (m_rootTransitions[i] != -1 && (m_rootTransitions[i] < 1 || m_rootTransitions[i] >= m_nodesAmount))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ContentBlockingMatcher::isEmpty() const
+{
+	return (m_outputsAmount == 0);
+}
+
+}
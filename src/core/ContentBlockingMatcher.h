@@ -0,0 +1,75 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_CONTENTBLOCKINGMATCHER_H
+#define OTTER_CONTENTBLOCKINGMATCHER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+namespace Otter
+{
+
+class ContentBlockingMatcher
+{
+public:
+	struct Match
+	{
+		int identifier;
+		int position;
+	};
+
+	ContentBlockingMatcher();
+
+	void addPattern(const QString &pattern, int identifier);
+	void compile();
+	void clear();
+	QByteArray getData() const;
+	QVector<Match> match(const QString &text) const;
+	int getMaximumIdentifier() const;
+	int getNodesAmount() const;
+	bool setData(const QByteArray &data);
+	bool isEmpty() const;
+
+protected:
+	void mapData();
+	int findTransition(int node, ushort character) const;
+	bool checkData() const;
+
+private:
+	QVector<QPair<QString, int> > m_patterns;
+	QByteArray m_data;
+	const qint32 *m_edgeOffsets;
+	const qint32 *m_edgeTargets;
+	const qint32 *m_failureLinks;
+	const qint32 *m_outputLinks;
+	const qint32 *m_outputOffsets;
+	const qint32 *m_outputIdentifiers;
+	const qint32 *m_depths;
+	const qint32 *m_rootTransitions;
+	const quint16 *m_edgeCharacters;
+	int m_nodesAmount;
+	int m_outputsAmount;
+};
+
+}
+
+#endif
@@ -24,11 +24,16 @@
 #include "ContentBlockingManager.h"
 #include "SessionsManager.h"
 
-#include <QtConcurrent/QtConcurrentRun>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
 #include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSaveFile>
 #include <QtCore/QSettings>
 #include <QtCore/QTextStream>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QtNetwork/QNetworkReply>
 #include <QtNetwork/QNetworkRequest>
 
@@ -38,20 +43,31 @@ namespace Otter
 NetworkManager* ContentBlockingProfile::m_networkManager = NULL;
 
 ContentBlockingProfile::ContentBlockingProfile(const QString &path, QObject *parent) : QObject(parent),
-	m_root(NULL),
 	m_networkReply(NULL),
+	m_ruleSetWatcher(NULL),
+	m_ruleSet(new RuleSet()),
 	m_updateRequested(false),
+	m_needsReload(false),
 	m_isEmpty(true),
+	m_isReady(false),
 	m_wasLoaded(false)
 {
 	m_information.name = QFileInfo(path).baseName();
 	m_information.title = tr("(Unknown)");
 	m_information.path = path;
 
-	load(true);
+	load();
+}
+
+ContentBlockingProfile::~ContentBlockingProfile()
+{
+	if (m_ruleSetWatcher)
+	{
+		m_ruleSetWatcher->waitForFinished();
+	}
 }
 
-void ContentBlockingProfile::load(bool onlyHeader)
+void ContentBlockingProfile::load()
 {
 	QFile file(m_information.path);
 
@@ -111,37 +127,29 @@ void ContentBlockingProfile::load(bool onlyHeader)
 	{
 		downloadUpdate();
 	}
-
-	if (!onlyHeader)
-	{
-		loadRules();
-	}
 }
 
-void ContentBlockingProfile::parseRuleLine(QString line)
+void ContentBlockingProfile::parseRuleLine(QString line, RuleSet *ruleSet, QHash<QString, int> &selectors)
 {
 	if (line.indexOf(QLatin1Char('!')) == 0 || line.isEmpty())
 	{
 		return;
 	}
 
-	if (line.startsWith(QLatin1String("##")))
-	{
-		m_styleSheet += line.mid(2) + QLatin1Char(',');
-
-		return;
-	}
+	const int styleSheetSeparator = line.indexOf(QLatin1String("##"));
 
-	if (line.contains(QLatin1String("##")))
+	if (styleSheetSeparator >= 0)
 	{
-		parseStyleSheetRule(line.split(QLatin1String("##")), m_styleSheetBlackList);
+		parseStyleSheetRule(line.left(styleSheetSeparator), line.mid(styleSheetSeparator + 2), false, ruleSet, selectors);
 
 		return;
 	}
 
-	if (line.contains(QLatin1String("#@#")))
+	const int styleSheetExceptionSeparator = line.indexOf(QLatin1String("#@#"));
+
+	if (styleSheetExceptionSeparator >= 0)
 	{
-		parseStyleSheetRule(line.split(QLatin1String("#@#")), m_styleSheetWhiteList);
+		parseStyleSheetRule(line.left(styleSheetExceptionSeparator), line.mid(styleSheetExceptionSeparator + 3), true, ruleSet, selectors);
 
 		return;
 	}
@@ -156,93 +164,124 @@ void ContentBlockingProfile::parseRuleLine(QString line)
 		line = line.left(optionSeparator);
 	}
 
-	while (line.endsWith(QLatin1Char('|')) || line.endsWith(QLatin1Char('*')) || line.endsWith(QLatin1Char('^')))
+	ContentBlockingRule rule;
+	rule.ruleOption = NoOption;
+	rule.exceptionRuleOption = NoOption;
+	rule.ruleMatch = ContainsMatch;
+	rule.keyPosition = 0;
+	rule.keyLength = 0;
+	rule.isException = false;
+	rule.isWildcard = false;
+	rule.needsDomainCheck = false;
+
+	if (line.startsWith(QLatin1String("@@")))
+	{
+		line = line.mid(2);
+
+		rule.isException = true;
+	}
+
+	if (line.startsWith(QLatin1String("||")))
+	{
+		line = line.mid(2);
+
+		rule.needsDomainCheck = true;
+	}
+	else if (line.startsWith(QLatin1Char('|')))
+	{
+		line = line.mid(1);
+
+		rule.ruleMatch = StartMatch;
+	}
+
+	if (line.endsWith(QLatin1Char('|')))
 	{
 		line = line.left(line.length() - 1);
+
+		rule.ruleMatch = ((rule.ruleMatch == StartMatch) ? ExactMatch : EndMatch);
 	}
 
-	if (line.startsWith(QLatin1Char('*')))
+	while (rule.ruleMatch != StartMatch && rule.ruleMatch != ExactMatch && !rule.needsDomainCheck && line.startsWith(QLatin1Char('*')))
 	{
 		line = line.mid(1);
 	}
 
-	if (line.contains(QLatin1Char('*')) || line.contains(QLatin1Char('^')))
+	while (rule.ruleMatch != EndMatch && rule.ruleMatch != ExactMatch && line.endsWith(QLatin1Char('*')))
 	{
-		// TODO
-		return;
+		line = line.left(line.length() - 1);
 	}
 
-	ContentBlockingRule *rule = new ContentBlockingRule();
-	rule->ruleOption = NoOption;
-	rule->exceptionRuleOption = NoOption;
-	rule->isException = false;
-	rule->needsDomainCheck = false;
+	int literalPosition = 0;
 
-	if (line.startsWith(QLatin1String("@@")))
+	for (int i = 0; i <= line.length(); ++i)
 	{
-		line = line.mid(2);
+		if (i == line.length() || line.at(i) == QLatin1Char('*') || line.at(i) == QLatin1Char('^'))
+		{
+			if ((i - literalPosition) > rule.keyLength)
+			{
+				rule.keyPosition = literalPosition;
+				rule.keyLength = (i - literalPosition);
+			}
 
-		rule->isException = true;
+			literalPosition = (i + 1);
+		}
 	}
 
-	if (line.startsWith(QLatin1String("||")))
+	if (rule.keyLength == 0)
 	{
-		line = line.mid(2);
-
-		rule->needsDomainCheck = true;
+		return;
 	}
 
+	rule.pattern = line;
+	rule.isWildcard = (rule.keyLength != line.length());
+
 	for (int i = 0; i < options.count(); ++i)
 	{
 		const bool optionException = options.at(i).startsWith(QLatin1Char('~'));
 
 		if (options.at(i).contains(QLatin1String("third-party")))
 		{
-			rule->ruleOption |= ThirdPartyOption;
-			rule->exceptionRuleOption |= (optionException ? ThirdPartyOption : NoOption);
+			rule.ruleOption |= ThirdPartyOption;
+			rule.exceptionRuleOption |= (optionException ? ThirdPartyOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("stylesheet")))
 		{
-			rule->ruleOption |= StyleSheetOption;
-			rule->exceptionRuleOption |= (optionException ? StyleSheetOption : NoOption);
+			rule.ruleOption |= StyleSheetOption;
+			rule.exceptionRuleOption |= (optionException ? StyleSheetOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("image")))
 		{
-			rule->ruleOption |= ImageOption;
-			rule->exceptionRuleOption |= (optionException ? ImageOption : NoOption);
+			rule.ruleOption |= ImageOption;
+			rule.exceptionRuleOption |= (optionException ? ImageOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("script")))
 		{
-			rule->ruleOption |= ScriptOption;
-			rule->exceptionRuleOption |= (optionException ? ScriptOption : NoOption);
+			rule.ruleOption |= ScriptOption;
+			rule.exceptionRuleOption |= (optionException ? ScriptOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("object")))
 		{
-			rule->ruleOption |= ObjectOption;
-			rule->exceptionRuleOption |= (optionException ? ObjectOption : NoOption);
+			rule.ruleOption |= ObjectOption;
+			rule.exceptionRuleOption |= (optionException ? ObjectOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("object-subrequest")) || options.at(i).contains(QLatin1String("object_subrequest")))
 		{
-			rule->ruleOption |= ObjectSubRequestOption;
-			rule->exceptionRuleOption |= (optionException ? ObjectSubRequestOption : NoOption);
+			rule.ruleOption |= ObjectSubRequestOption;
+			rule.exceptionRuleOption |= (optionException ? ObjectSubRequestOption : NoOption);
 			// TODO
-			delete rule;
-
 			return;
 		}
 		else if (options.at(i).contains(QLatin1String("subdocument")))
 		{
-			rule->ruleOption |= SubDocumentOption;
-			rule->exceptionRuleOption |= (optionException ? SubDocumentOption : NoOption);
+			rule.ruleOption |= SubDocumentOption;
+			rule.exceptionRuleOption |= (optionException ? SubDocumentOption : NoOption);
 			// TODO
-			delete rule;
-
 			return;
 		}
 		else if (options.at(i).contains(QLatin1String("xmlhttprequest")))
 		{
-			rule->ruleOption |= XmlHttpRequestOption;
-			rule->exceptionRuleOption |= (optionException ? XmlHttpRequestOption : NoOption);
+			rule.ruleOption |= XmlHttpRequestOption;
+			rule.exceptionRuleOption |= (optionException ? XmlHttpRequestOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("domain")))
 		{
@@ -252,176 +291,96 @@ void ContentBlockingProfile::parseRuleLine(QString line)
 			{
 				if (parsedDomains.at(j).startsWith(QLatin1Char('~')))
 				{
-					rule->allowedDomains.append(parsedDomains.at(j).mid(1));
+					rule.allowedDomains.append(parsedDomains.at(j).mid(1));
 
 					continue;
 				}
 
-				rule->blockedDomains.append(parsedDomains.at(j));
+				rule.blockedDomains.append(parsedDomains.at(j));
 			}
 		}
 		else
 		{
 			// TODO - document, elemhide
-			delete rule;
-
 			return;
 		}
 	}
 
-	addRule(rule, line);
-
-	return;
-}
-
-void ContentBlockingProfile::parseStyleSheetRule(const QStringList &line, QMultiHash<QString, QString> &list)
-{
-	const QStringList domains = line.at(0).split(QLatin1Char(','));
+	const QString domainKey = getDomainRuleKey(rule);
 
-	for (int i = 0; i < domains.count(); ++i)
+	if (domainKey.isEmpty())
 	{
-		list.insert(domains.at(i), line.at(1));
-	}
-}
+		ruleSet->matcher.addPattern(line.mid(rule.keyPosition, rule.keyLength), ruleSet->rules.count());
 
-void ContentBlockingProfile::resolveRuleOptions(ContentBlockingRule *rule, const QNetworkRequest &request, bool &isBlocked)
-{
-	const QString url = request.url().url();
-	const QByteArray requestHeader = request.rawHeader(QByteArray("Accept"));
-	const QString baseUrlHost = m_baseUrl.host();
-
-	isBlocked = ((rule->allowedDomains.count() > 0) ? !resolveDomainExceptions(baseUrlHost, rule->allowedDomains) : isBlocked);
-	isBlocked = ((rule->blockedDomains.count() > 0) ? resolveDomainExceptions(baseUrlHost, rule->blockedDomains) : isBlocked);
-
-	if (rule->ruleOption & ThirdPartyOption)
-	{
-		if (baseUrlHost.isEmpty() || m_requestSubdomainList.contains(baseUrlHost))
-		{
-			isBlocked = (rule->exceptionRuleOption & ThirdPartyOption);
-		}
-		else
+		if (rule.isException)
 		{
-			isBlocked = !(rule->exceptionRuleOption & ThirdPartyOption);
+			ruleSet->exceptionsMatcher.addPattern(line.mid(rule.keyPosition, rule.keyLength), ruleSet->rules.count());
 		}
 	}
-
-	if (rule->ruleOption & ImageOption)
+	else
 	{
-		if (requestHeader.contains(QByteArray("image/")) || url.endsWith(QLatin1String(".png")) || url.endsWith(QLatin1String(".jpg")) || url.endsWith(QLatin1String(".gif")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & ImageOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & ImageOption) : isBlocked);
-		}
+		ruleSet->domainRules.insert(domainKey, ruleSet->rules.count());
 	}
 
-	if (rule->ruleOption & ScriptOption)
+	ruleSet->rules.append(rule);
+}
+
+void ContentBlockingProfile::parseStyleSheetRule(const QString &domainList, const QString &selector, bool isException, RuleSet *ruleSet, QHash<QString, int> &selectors)
+{
+	if (!isValidSelector(selector))
 	{
-		if (requestHeader.contains(QByteArray("script/")) || url.endsWith(QLatin1String(".js")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & ScriptOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & ScriptOption) : isBlocked);
-		}
+		return;
 	}
 
-	if (rule->ruleOption & StyleSheetOption)
+	int identifier = selectors.value(selector, -1);
+
+	if (identifier < 0)
 	{
-		if (requestHeader.contains(QByteArray("text/css")) || url.endsWith(QLatin1String(".css")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & StyleSheetOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & StyleSheetOption) : isBlocked);
-		}
+		identifier = ruleSet->selectors.count();
+
+		ruleSet->selectors.append(selector);
+
+		selectors[selector] = identifier;
 	}
 
-	if (rule->ruleOption & ObjectOption)
+	const QStringList domains = domainList.split(QLatin1Char(','), QString::SkipEmptyParts);
+	bool hasIncludedDomains = false;
+
+	for (int i = 0; i < domains.count(); ++i)
 	{
-		if (requestHeader.contains(QByteArray("object")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & ObjectOption) : isBlocked);
-		}
-		else
+		if (domains.at(i).startsWith(QLatin1Char('~')))
 		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & ObjectOption) : isBlocked);
-		}
-	}
+			if (!isException)
+			{
+				ruleSet->domainSelectorExceptions[domains.at(i).mid(1)].append(identifier);
+			}
 
-	if (rule->ruleOption & SubDocumentOption)
-	{
-		// TODO
-	}
+			continue;
+		}
 
-	if (rule->ruleOption & ObjectSubRequestOption)
-	{
-		// TODO
-	}
+		hasIncludedDomains = true;
 
-	if (rule->ruleOption & XmlHttpRequestOption)
-	{
-		if (request.rawHeader(QByteArray("X-Requested-With")) == QByteArray("XMLHttpRequest"))
+		if (isException)
 		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & XmlHttpRequestOption) : isBlocked);
+			ruleSet->domainSelectorExceptions[domains.at(i)].append(identifier);
 		}
 		else
 		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & XmlHttpRequestOption) : isBlocked);
+			ruleSet->domainSelectors[domains.at(i)].append(identifier);
 		}
 	}
-}
 
-void ContentBlockingProfile::addRule(ContentBlockingRule *rule, const QString &ruleString)
-{
-	Node *node = m_root;
-
-	for (int i = 0; i < ruleString.length(); ++i)
+	if (!hasIncludedDomains)
 	{
-		const QChar value = ruleString.at(i);
-		bool childrenExists = false;
-
-		for (int j = 0; j < node->children.count(); ++j)
+		if (isException)
 		{
-			Node *nextNode = node->children.at(j);
-
-			if (nextNode->value == value)
-			{
-				node = nextNode;
-
-				childrenExists = true;
-
-				break;
-			}
+			ruleSet->domainSelectorExceptions[QString()].append(identifier);
 		}
-
-		if (!childrenExists)
+		else
 		{
-			Node *newNode = new Node;
-			newNode->value = value;
-
-			node->children.append(newNode);
-
-			node = newNode;
+			ruleSet->genericSelectors.append(identifier);
 		}
 	}
-
-	node->rule = rule;
-}
-
-void ContentBlockingProfile::deleteNode(Node *node)
-{
-	for (int j = 0; j < node->children.count(); ++j)
-	{
-		deleteNode(node->children.at(j));
-	}
-
-	delete node->rule;
-	delete node;
 }
 
 void ContentBlockingProfile::downloadUpdate()
@@ -494,9 +453,33 @@ void ContentBlockingProfile::updateDownloaded(QNetworkReply *reply)
 		}
 	}
 
-	QFile file(m_information.path);
+	const QByteArray data = (downloadedDataHeader + QStringLiteral("! URL: %1\n").arg(m_information.updateUrl.toString()).toUtf8() + downloadedDataChecksum + downloadedData);
+
+// list is being read in background, so it is replaced once that is finished
+	if (m_ruleSetWatcher)
+	{
+		m_updateData = data;
+
+		return;
+	}
+
+	saveUpdate(data);
+}
+
+void ContentBlockingProfile::saveUpdate(const QByteArray &data)
+{
+	QSaveFile file(m_information.path);
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		Console::addMessage(QCoreApplication::translate("main", "Failed to update content blocking profile: %1").arg(file.errorString()), Otter::OtherMessageCategory, ErrorMessageLevel, m_information.path);
 
-	if (!file.open(QFile::ReadWrite | QFile::Truncate))
+		return;
+	}
+
+	file.write(data);
+
+	if (!file.commit())
 	{
 		Console::addMessage(QCoreApplication::translate("main", "Failed to update content blocking profile: %1").arg(file.errorString()), Otter::OtherMessageCategory, ErrorMessageLevel, m_information.path);
 
@@ -506,40 +489,134 @@ void ContentBlockingProfile::updateDownloaded(QNetworkReply *reply)
 	QSettings profilesSettings(SessionsManager::getWritableDataPath(QLatin1String("contentBlocking.ini")), QSettings::IniFormat);
 	profilesSettings.setValue(m_information.name + QLatin1String("/lastUpdate"), QDateTime::currentDateTime().toString(Qt::ISODate));
 
-	file.write(downloadedDataHeader);
-	file.write(QStringLiteral("! URL: %1\n").arg(m_information.updateUrl.toString()).toUtf8());
-	file.write(downloadedDataChecksum);
-	file.write(downloadedData);
-	file.close();
+	load();
+
+	QMutexLocker locker(&m_ruleSetMutex);
 
-	if (file.error() != QFile::NoError)
+	if (m_wasLoaded)
 	{
-// TODO
+		locker.unlock();
+
+		loadRuleSet();
 	}
+}
 
-	if (m_wasLoaded)
+void ContentBlockingProfile::loadRuleSet()
+{
+	if (m_ruleSetWatcher)
 	{
-		if (m_root)
-		{
-			QtConcurrent::run(this, &ContentBlockingProfile::deleteNode, m_root);
-		}
+		m_needsReload = true;
+
+		return;
+	}
+
+	m_ruleSetWatcher = new QFutureWatcher<QSharedPointer<RuleSet> >(this);
+
+	connect(m_ruleSetWatcher, SIGNAL(finished()), this, SLOT(ruleSetLoaded()));
+
+	m_loadTimer.start();
+	m_ruleSetWatcher->setFuture(QtConcurrent::run(this, &ContentBlockingProfile::loadRules));
+}
+
+void ContentBlockingProfile::ruleSetLoaded()
+{
+	const QSharedPointer<const RuleSet> ruleSet = m_ruleSetWatcher->result();
+
+	m_ruleSetWatcher->deleteLater();
+	m_ruleSetWatcher = NULL;
+
+	m_ruleSetMutex.lock();
+
+	m_ruleSet = ruleSet;
+	m_isReady = true;
+
+	m_ruleSetMutex.unlock();
+
+	Console::addMessage(QCoreApplication::translate("main", "Loaded content blocking profile in %1 ms: %2 rules, %3 element hiding selectors, %4 KiB of compiled automatons").arg(m_loadTimer.elapsed()).arg(ruleSet->rules.count()).arg(ruleSet->selectors.count()).arg((ruleSet->matcher.getData().size() + ruleSet->exceptionsMatcher.getData().size()) / 1024), Otter::OtherMessageCategory, LogMessageLevel, m_information.path);
+
+	emit updateCustomStyleSheets();
+	emit profileModified(m_information.name);
+
+	if (!m_updateData.isEmpty())
+	{
+		const QByteArray data = m_updateData;
+
+		m_updateData.clear();
+
+		saveUpdate(data);
+	}
+
+// reload started for updated list covers pending request too
+	if (m_ruleSetWatcher)
+	{
+		m_needsReload = false;
+	}
+	else if (m_needsReload)
+	{
+		m_needsReload = false;
+
+		loadRuleSet();
+	}
+}
+
+void ContentBlockingProfile::handleCacheError(const QString &error)
+{
+	Console::addMessage(QCoreApplication::translate("main", "Failed to save content blocking profile cache: %1").arg(error), Otter::OtherMessageCategory, ErrorMessageLevel, getCachePath());
+}
+
+QString ContentBlockingProfile::getStyleSheet(const QString &host)
+{
+	const QSharedPointer<const RuleSet> ruleSet = getRuleSet();
+
+	if (host.isEmpty() || (ruleSet->domainSelectors.isEmpty() && ruleSet->domainSelectorExceptions.isEmpty()))
+	{
+		return ruleSet->styleSheet;
+	}
+
+	const QStringList domains = ContentBlockingManager::createSubdomainList(host);
+	QVector<int> selectors;
+	QVector<int> exceptions;
+
+	for (int i = 0; i < domains.count(); ++i)
+	{
+		selectors += ruleSet->domainSelectors.value(domains.at(i));
+		exceptions += ruleSet->domainSelectorExceptions.value(domains.at(i));
+	}
+
+	if (selectors.isEmpty() && exceptions.isEmpty())
+	{
+		return ruleSet->styleSheet;
+	}
 
-		m_styleSheet.clear();
-		m_styleSheetWhiteList.clear();
-		m_styleSheetBlackList.clear();
+// generic selectors are already combined, they need to be rebuilt only when some of them are disabled for this host
+	if (exceptions.isEmpty())
+	{
+		return ruleSet->styleSheet + createStyleSheet(ruleSet->selectors, selectors, exceptions);
 	}
 
-	load(!m_wasLoaded);
+	return createStyleSheet(ruleSet->selectors, (ruleSet->genericSelectors + selectors), exceptions);
+}
+
+QString ContentBlockingProfile::getCachePath() const
+{
+	const QFileInfo information(m_information.path);
+
+	return information.absoluteDir().filePath(information.completeBaseName() + QLatin1String(".dat"));
 }
 
-QString ContentBlockingProfile::getStyleSheet()
+QByteArray ContentBlockingProfile::getChecksum() const
 {
-	if (!m_wasLoaded)
+	QFile file(m_information.path);
+
+	if (!file.open(QIODevice::ReadOnly))
 	{
-		loadRules();
+		return QByteArray();
 	}
 
-	return m_styleSheet;
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(&file);
+
+	return hash.result();
 }
 
 ContentBlockingInformation ContentBlockingProfile::getInformation() const
@@ -547,189 +624,706 @@ ContentBlockingInformation ContentBlockingProfile::getInformation() const
 	return m_information;
 }
 
-QMultiHash<QString, QString> ContentBlockingProfile::getStyleSheetWhiteList()
+QSharedPointer<const ContentBlockingProfile::RuleSet> ContentBlockingProfile::getRuleSet()
 {
-	if (!m_wasLoaded)
+	QMutexLocker locker(&m_ruleSetMutex);
+
+	if (m_wasLoaded)
 	{
-		loadRules();
+		return m_ruleSet;
 	}
 
-	return m_styleSheetBlackList;
+	m_wasLoaded = true;
+
+// until rules are compiled in background, previous set (or empty one, passing all requests) is used
+	QMetaObject::invokeMethod(this, (m_isEmpty ? "downloadUpdate" : "loadRuleSet"), Qt::QueuedConnection);
+
+	return m_ruleSet;
 }
 
-QMultiHash<QString, QString> ContentBlockingProfile::getStyleSheetBlackList()
+QSharedPointer<ContentBlockingProfile::RuleSet> ContentBlockingProfile::loadRules()
 {
-	if (!m_wasLoaded)
+	QSharedPointer<RuleSet> ruleSet(new RuleSet());
+
+	if (loadCache(ruleSet.data()))
+	{
+		return ruleSet;
+	}
+
+	QFile file(m_information.path);
+
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return ruleSet;
+	}
+
+// state of source is recorded before reading it, so cache never claims to be built from newer list than it was
+	const qint64 sourceModified = QFileInfo(m_information.path).lastModified().toMSecsSinceEpoch();
+	const QByteArray data = file.readAll();
+
+	file.close();
+
+	QHash<QString, int> selectors;
+	QTextStream stream(data, QIODevice::ReadOnly);
+
+	stream.readLine(); // header
+
+	while (!stream.atEnd())
+	{
+		parseRuleLine(stream.readLine(), ruleSet.data(), selectors);
+	}
+
+	ruleSet->matcher.compile();
+	ruleSet->exceptionsMatcher.compile();
+	ruleSet->rules.squeeze();
+
+	const QVector<int> genericExceptions = ruleSet->domainSelectorExceptions.take(QString());
+
+	for (int i = (ruleSet->genericSelectors.count() - 1); i >= 0; --i)
+	{
+		if (genericExceptions.contains(ruleSet->genericSelectors.at(i)))
+		{
+			ruleSet->genericSelectors.remove(i);
+		}
+	}
+
+	ruleSet->styleSheet = createStyleSheet(ruleSet->selectors, ruleSet->genericSelectors, QVector<int>());
+
+	const QFileInfo sourceInformation(m_information.path);
+
+	if (sourceInformation.size() == data.size() && sourceInformation.lastModified().toMSecsSinceEpoch() == sourceModified)
 	{
-		loadRules();
+		saveCache(ruleSet.data(), data.size(), sourceModified, QCryptographicHash::hash(data, QCryptographicHash::Md5));
 	}
 
-	return m_styleSheetWhiteList;
+	return ruleSet;
 }
 
-bool ContentBlockingProfile::loadRules()
+bool ContentBlockingProfile::loadCache(RuleSet *ruleSet) const
 {
-	if (m_isEmpty)
+	QFile file(getCachePath());
+
+	if (!file.open(QIODevice::ReadOnly))
 	{
-		downloadUpdate();
+		return false;
+	}
 
+	const qint64 size = file.size();
+	const uchar *data = file.map(0, size);
+
+	if (!data)
+	{
 		return false;
 	}
 
-	m_wasLoaded = true;
+	const QFileInfo sourceInformation(m_information.path);
+	const QByteArray cache(QByteArray::fromRawData(reinterpret_cast<const char*>(data), size));
+	QDataStream stream(cache);
+	stream.setVersion(QDataStream::Qt_5_2);
+
+	quint32 magic;
+	quint32 version;
+	qint64 sourceSize;
+	qint64 sourceModified;
+	QByteArray sourceChecksum;
 
-	if (m_domainExpression.pattern().isEmpty())
+	stream >> magic >> version >> sourceSize >> sourceModified >> sourceChecksum;
+
+	if (stream.status() != QDataStream::Ok || magic != 0x4f43424c || version != 5)
 	{
-		m_domainExpression = QRegularExpression(QLatin1String("[:\?&/=]"));
-#if QT_VERSION >= 0x050400
-		m_domainExpression.optimize();
-#endif
+		return false;
 	}
 
-	QFile file(m_information.path);
+	if ((sourceSize != sourceInformation.size() || sourceModified != sourceInformation.lastModified().toMSecsSinceEpoch()) && sourceChecksum != getChecksum())
+	{
+		return false;
+	}
 
-	file.open(QIODevice::ReadOnly | QIODevice::Text);
+	QString styleSheet;
+	QStringList selectors;
+	QVector<int> genericSelectors;
+	QHash<QString, QVector<int> > domainSelectors;
+	QHash<QString, QVector<int> > domainSelectorExceptions;
+	quint32 rulesAmount;
 
-	QTextStream stream(&file);
+	stream >> styleSheet >> selectors >> genericSelectors >> domainSelectors >> domainSelectorExceptions >> rulesAmount;
 
-	stream.readLine(); // header
+	if (stream.status() != QDataStream::Ok || rulesAmount > static_cast<quint32>(size) || !checkSelectors(genericSelectors, selectors.count()))
+	{
+		return false;
+	}
 
-	m_root = new Node();
+	QHash<QString, QVector<int> >::const_iterator selectorsIterator;
 
-	while (!stream.atEnd())
+	for (selectorsIterator = domainSelectors.constBegin(); selectorsIterator != domainSelectors.constEnd(); ++selectorsIterator)
 	{
-		parseRuleLine(stream.readLine());
+		if (!checkSelectors(selectorsIterator.value(), selectors.count()))
+		{
+			return false;
+		}
 	}
 
-	file.close();
+	for (selectorsIterator = domainSelectorExceptions.constBegin(); selectorsIterator != domainSelectorExceptions.constEnd(); ++selectorsIterator)
+	{
+		if (!checkSelectors(selectorsIterator.value(), selectors.count()))
+		{
+			return false;
+		}
+	}
+
+	QVector<ContentBlockingRule> rules;
+	rules.reserve(rulesAmount);
 
-	if (m_styleSheet.length() > 0)
+	for (quint32 i = 0; i < rulesAmount; ++i)
 	{
-		m_styleSheet = m_styleSheet.left(m_styleSheet.length() - 1);
-		m_styleSheet += QLatin1String("{display:none;}");
+		ContentBlockingRule rule;
+		qint32 ruleOption;
+		qint32 exceptionRuleOption;
+		qint32 ruleMatch;
+		qint32 keyPosition;
+		qint32 keyLength;
+
+		stream >> rule.pattern >> rule.blockedDomains >> rule.allowedDomains >> ruleOption >> exceptionRuleOption >> ruleMatch >> keyPosition >> keyLength >> rule.isException >> rule.isWildcard >> rule.needsDomainCheck;
+
+		rule.ruleOption = RuleOptions(QFlag(ruleOption));
+		rule.exceptionRuleOption = RuleOptions(QFlag(exceptionRuleOption));
+		rule.ruleMatch = static_cast<RuleMatch>(ruleMatch);
+		rule.keyPosition = keyPosition;
+		rule.keyLength = keyLength;
+
+		rules.append(rule);
 	}
 
-	emit updateCustomStyleSheets();
+	QMultiHash<QString, int> domainRules;
+	qint64 matcherOffset;
+	qint64 matcherSize;
+	qint64 exceptionsMatcherOffset;
+	qint64 exceptionsMatcherSize;
+
+	stream >> domainRules >> matcherOffset >> matcherSize >> exceptionsMatcherOffset >> exceptionsMatcherSize;
+
+	if (stream.status() != QDataStream::Ok || matcherOffset <= 0 || (matcherOffset % 8) != 0 || (matcherOffset + matcherSize) > size || exceptionsMatcherOffset <= 0 || (exceptionsMatcherOffset % 8) != 0 || (exceptionsMatcherOffset + exceptionsMatcherSize) > size)
+	{
+		return false;
+	}
+
+	QMultiHash<QString, int>::const_iterator iterator;
+
+	for (iterator = domainRules.constBegin(); iterator != domainRules.constEnd(); ++iterator)
+	{
+		if (iterator.value() < 0 || iterator.value() >= rules.count())
+		{
+			return false;
+		}
+	}
+
+// automatons are copied out of mapping, so file is not kept open and it can be replaced when list is updated
+	if (!ruleSet->matcher.setData(QByteArray(reinterpret_cast<const char*>(data + matcherOffset), matcherSize)) || !ruleSet->exceptionsMatcher.setData(QByteArray(reinterpret_cast<const char*>(data + exceptionsMatcherOffset), exceptionsMatcherSize)) || ruleSet->matcher.getMaximumIdentifier() >= rules.count() || ruleSet->exceptionsMatcher.getMaximumIdentifier() >= rules.count())
+	{
+		ruleSet->matcher.clear();
+		ruleSet->exceptionsMatcher.clear();
+
+		return false;
+	}
+
+	ruleSet->styleSheet = styleSheet;
+	ruleSet->selectors = selectors;
+	ruleSet->genericSelectors = genericSelectors;
+	ruleSet->domainSelectors = domainSelectors;
+	ruleSet->domainSelectorExceptions = domainSelectorExceptions;
+	ruleSet->rules = rules;
+	ruleSet->domainRules = domainRules;
+
+	file.unmap(const_cast<uchar*>(data));
 
 	return true;
 }
 
-bool ContentBlockingProfile::resolveDomainExceptions(const QString &url, const QStringList &ruleList)
+void ContentBlockingProfile::saveCache(const RuleSet *ruleSet, qint64 sourceSize, qint64 sourceModified, const QByteArray &sourceChecksum)
 {
-	for (int i = 0; i < ruleList.count(); ++i)
+	QSaveFile file(getCachePath());
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		QMetaObject::invokeMethod(this, "handleCacheError", Qt::QueuedConnection, Q_ARG(QString, file.errorString()));
+
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_2);
+	stream << static_cast<quint32>(0x4f43424c) << static_cast<quint32>(5) << sourceSize << sourceModified << sourceChecksum;
+	stream << ruleSet->styleSheet << ruleSet->selectors << ruleSet->genericSelectors << ruleSet->domainSelectors << ruleSet->domainSelectorExceptions << static_cast<quint32>(ruleSet->rules.count());
+
+	for (int i = 0; i < ruleSet->rules.count(); ++i)
+	{
+		const ContentBlockingRule &rule = ruleSet->rules.at(i);
+
+		stream << rule.pattern << rule.blockedDomains << rule.allowedDomains << static_cast<qint32>(rule.ruleOption) << static_cast<qint32>(rule.exceptionRuleOption) << static_cast<qint32>(rule.ruleMatch) << static_cast<qint32>(rule.keyPosition) << static_cast<qint32>(rule.keyLength) << rule.isException << rule.isWildcard << rule.needsDomainCheck;
+	}
+
+	stream << ruleSet->domainRules;
+
+// automatons are mapped directly from file, so they need to start at aligned offsets
+	const QByteArray matcherData = ruleSet->matcher.getData();
+	const QByteArray exceptionsMatcherData = ruleSet->exceptionsMatcher.getData();
+	const qint64 matcherOffset = (((file.pos() + (4 * sizeof(qint64)) + 7) / 8) * 8);
+	const qint64 exceptionsMatcherOffset = (((matcherOffset + matcherData.size() + 7) / 8) * 8);
+
+	stream << matcherOffset << static_cast<qint64>(matcherData.size()) << exceptionsMatcherOffset << static_cast<qint64>(exceptionsMatcherData.size());
+
+	file.write(QByteArray((matcherOffset - file.pos()), 0));
+	file.write(matcherData);
+	file.write(QByteArray((exceptionsMatcherOffset - file.pos()), 0));
+	file.write(exceptionsMatcherData);
+
+	if (!file.commit())
+	{
+		QMetaObject::invokeMethod(this, "handleCacheError", Qt::QueuedConnection, Q_ARG(QString, file.errorString()));
+	}
+}
+
+QString ContentBlockingProfile::createStyleSheet(const QStringList &selectors, const QVector<int> &identifiers, const QVector<int> &exceptions)
+{
+	QString styleSheet;
+	QVector<bool> isUsed(selectors.count(), false);
+	int amount = 0;
+
+	for (int i = 0; i < exceptions.count(); ++i)
+	{
+		isUsed[exceptions.at(i)] = true;
+	}
+
+// whole rule is dropped when any of its selectors is not supported, so they are split into small groups to limit the damage
+	for (int i = 0; i < identifiers.count(); ++i)
 	{
-		if (url.contains(ruleList.at(i)))
+		if (isUsed.at(identifiers.at(i)))
 		{
-			return true;
+			continue;
+		}
+
+		isUsed[identifiers.at(i)] = true;
+
+		if (amount > 0)
+		{
+			styleSheet += QLatin1Char(',');
+		}
+
+		styleSheet += selectors.at(identifiers.at(i));
+
+		++amount;
+
+		if (amount == 50)
+		{
+			styleSheet += QLatin1String("{display:none;}");
+
+			amount = 0;
 		}
 	}
 
-	return false;
+	if (amount > 0)
+	{
+		styleSheet += QLatin1String("{display:none;}");
+	}
+
+	return styleSheet;
+}
+
+ContentBlockingProfile::RequestInformation ContentBlockingProfile::getRequestInformation(const QNetworkRequest &request, const QString &url, const QUrl &baseUrl)
+{
+	const QString host = request.url().host();
+	RuleOptions options = getResourceType(request, url);
+	RequestInformation information;
+	information.url = url;
+	information.baseHost = baseUrl.host();
+	information.hostStart = qMax(0, url.indexOf(host));
+	information.hostEnd = (information.hostStart + host.length());
+
+	if (!information.baseHost.isEmpty() && !ContentBlockingManager::createSubdomainList(host).contains(information.baseHost))
+	{
+		options |= ThirdPartyOption;
+	}
+
+	information.options = options;
+
+	return information;
+}
+
+ContentBlockingProfile::RuleOptions ContentBlockingProfile::getResourceType(const QNetworkRequest &request, const QString &url)
+{
+	const QByteArray acceptHeader = request.rawHeader(QByteArray("Accept"));
+	RuleOptions options = NoOption;
+
+	if (acceptHeader.contains(QByteArray("image/")) || url.endsWith(QLatin1String(".png")) || url.endsWith(QLatin1String(".jpg")) || url.endsWith(QLatin1String(".gif")))
+	{
+		options |= ImageOption;
+	}
+
+	if (acceptHeader.contains(QByteArray("script/")) || url.endsWith(QLatin1String(".js")))
+	{
+		options |= ScriptOption;
+	}
+
+	if (acceptHeader.contains(QByteArray("text/css")) || url.endsWith(QLatin1String(".css")))
+	{
+		options |= StyleSheetOption;
+	}
+
+	if (acceptHeader.contains(QByteArray("object")))
+	{
+		options |= ObjectOption;
+	}
+
+	if (request.rawHeader(QByteArray("X-Requested-With")) == QByteArray("XMLHttpRequest"))
+	{
+		options |= XmlHttpRequestOption;
+	}
+
+	return options;
+}
+
+QString ContentBlockingProfile::getDomainRuleKey(const ContentBlockingRule &rule)
+{
+	if (!rule.needsDomainCheck || rule.ruleMatch != ContainsMatch || !rule.isWildcard || rule.keyPosition != 0 || rule.pattern.length() != (rule.keyLength + 1) || !rule.pattern.endsWith(QLatin1Char('^')))
+	{
+		return QString();
+	}
+
+	const QString domain = rule.pattern.left(rule.keyLength).toLower();
+
+	for (int i = 0; i < domain.length(); ++i)
+	{
+		if (!domain.at(i).isLetterOrNumber() && domain.at(i) != QLatin1Char('.') && domain.at(i) != QLatin1Char('-') && domain.at(i) != QLatin1Char('_'))
+		{
+			return QString();
+		}
+	}
+
+	return getReversedHost(domain);
 }
 
-bool ContentBlockingProfile::checkUrlSubstring(const QString &subString, const QNetworkRequest &request)
+QString ContentBlockingProfile::getReversedHost(const QString &host)
 {
-	Node *node = m_root;
-	m_currentRule.clear();
+	const QStringList labels = host.split(QLatin1Char('.'));
+	QString reversedHost;
+	reversedHost.reserve(host.length());
 
-	for (int i = 0; i < subString.length(); ++i)
+	for (int i = (labels.count() - 1); i >= 0; --i)
 	{
-		const QChar treeChar = subString.at(i);
+		reversedHost += labels.at(i);
 
-		if (node->rule && checkRuleMatch(node->rule, request))
+		if (i > 0)
 		{
-			return true;
+			reversedHost += QLatin1Char('.');
 		}
+	}
 
-		bool childrenExists = false;
+	return reversedHost;
+}
 
-		for (int j = 0; j < node->children.count(); ++j)
+bool ContentBlockingProfile::checkSelectors(const QVector<int> &identifiers, int amount)
+{
+	for (int i = 0; i < identifiers.count(); ++i)
+	{
+		if (identifiers.at(i) < 0 || identifiers.at(i) >= amount)
 		{
-			Node *nextNode = node->children.at(j);
+			return false;
+		}
+	}
 
-			if (nextNode->value == treeChar)
-			{
-				node = nextNode;
+	return true;
+}
 
-				childrenExists = true;
+bool ContentBlockingProfile::isValidSelector(const QString &selector)
+{
+	if (selector.isEmpty() || selector.contains(QLatin1Char('{')) || selector.contains(QLatin1Char('}')) || selector.contains(QLatin1Char(';')))
+	{
+		return false;
+	}
 
-				break;
-			}
-		}
+// extended selectors of Adblock Plus and similar blockers are not understood by CSS engines
+	const QStringList extensions = QStringList() << QLatin1String(":-abp-") << QLatin1String(":has(") << QLatin1String(":has-text(") << QLatin1String(":contains(") << QLatin1String(":matches-css") << QLatin1String(":xpath(") << QLatin1String(":style(");
 
-		if (!childrenExists)
+	for (int i = 0; i < extensions.count(); ++i)
+	{
+		if (selector.contains(extensions.at(i)))
 		{
 			return false;
 		}
+	}
 
-		m_currentRule += treeChar;
+	QVector<QChar> brackets;
+	QChar quote;
+
+	for (int i = 0; i < selector.length(); ++i)
+	{
+		const QChar character = selector.at(i);
+
+		if (!quote.isNull())
+		{
+			if (character == QLatin1Char('\\'))
+			{
+				++i;
+			}
+			else if (character == quote)
+			{
+				quote = QChar();
+			}
+		}
+		else if (character == QLatin1Char('\\'))
+		{
+			++i;
+		}
+		else if (character == QLatin1Char('"') || character == QLatin1Char('\''))
+		{
+			quote = character;
+		}
+		else if (character == QLatin1Char('(') || character == QLatin1Char('['))
+		{
+			brackets.append((character == QLatin1Char('(')) ? QLatin1Char(')') : QLatin1Char(']'));
+		}
+		else if (character == QLatin1Char(')') || character == QLatin1Char(']'))
+		{
+			if (brackets.isEmpty() || brackets.last() != character)
+			{
+				return false;
+			}
+
+			brackets.removeLast();
+		}
 	}
 
-	if (node->rule && checkRuleMatch(node->rule, request))
+	return (quote.isNull() && brackets.isEmpty());
+}
+
+bool ContentBlockingProfile::resolveDomainExceptions(const QString &host, const QStringList &ruleList)
+{
+	for (int i = 0; i < ruleList.count(); ++i)
 	{
-		return true;
+		if (host == ruleList.at(i) || host.endsWith(QLatin1Char('.') + ruleList.at(i)))
+		{
+			return true;
+		}
 	}
 
 	return false;
 }
 
-bool ContentBlockingProfile::checkRuleMatch(ContentBlockingRule *rule, const QNetworkRequest &request)
+bool ContentBlockingProfile::checkRuleOptions(const ContentBlockingRule &rule, RuleOptions requestOptions, const QString &baseHost)
 {
-	bool isBlocked = false;
+	if (!rule.blockedDomains.isEmpty() && !resolveDomainExceptions(baseHost, rule.blockedDomains))
+	{
+		return false;
+	}
+
+	if (!rule.allowedDomains.isEmpty() && resolveDomainExceptions(baseHost, rule.allowedDomains))
+	{
+		return false;
+	}
+
+	if (rule.ruleOption.testFlag(ThirdPartyOption) && requestOptions.testFlag(ThirdPartyOption) == rule.exceptionRuleOption.testFlag(ThirdPartyOption))
+	{
+		return false;
+	}
+
+	const int typeOptions = (StyleSheetOption | ScriptOption | ImageOption | ObjectOption | XmlHttpRequestOption);
+	const int requestTypes = (requestOptions & typeOptions);
+	const int includedTypes = (rule.ruleOption & ~rule.exceptionRuleOption & typeOptions);
+
+	if (includedTypes != 0 && (requestTypes & includedTypes) == 0)
+	{
+		return false;
+	}
+
+	return ((requestTypes & rule.exceptionRuleOption & typeOptions) == 0);
+}
+
+bool ContentBlockingProfile::checkRulePattern(const ContentBlockingRule &rule, const QString &url, int position, int hostStart, int hostEnd)
+{
+	const bool matchStart = (rule.ruleMatch == StartMatch || rule.ruleMatch == ExactMatch);
+	const bool matchEnd = (rule.ruleMatch == EndMatch || rule.ruleMatch == ExactMatch);
 
-	if (request.url().url().contains(m_currentRule))
+	if (!rule.isWildcard)
 	{
-		m_requestSubdomainList = ContentBlockingManager::createSubdomainList(request.url().host());
+		if ((matchStart && position != 0) || (matchEnd && (position + rule.pattern.length()) != url.length()))
+		{
+			return false;
+		}
+
+		return (!rule.needsDomainCheck || (position >= hostStart && position < hostEnd && (position == hostStart || url.at(position - 1) == QLatin1Char('.'))));
+	}
 
-		if (rule->needsDomainCheck)
+	if (rule.needsDomainCheck)
+	{
+		for (int i = hostStart; i < hostEnd; ++i)
 		{
-			if (!m_requestSubdomainList.contains(m_currentRule.left(m_currentRule.indexOf(m_domainExpression))))
+			if ((i == hostStart || url.at(i - 1) == QLatin1Char('.')) && matchWildcard(rule.pattern, url, i, true, matchEnd))
 			{
-				return false;
+				return true;
 			}
-			else
+		}
+
+		return false;
+	}
+
+	return matchWildcard(rule.pattern, url, 0, matchStart, matchEnd);
+}
+
+bool ContentBlockingProfile::matchWildcard(const QString &pattern, const QString &url, int position, bool matchStart, bool matchEnd)
+{
+	const int patternLength = pattern.length();
+	const int urlLength = url.length();
+	int patternPosition = 0;
+	int urlPosition = position;
+	int wildcardPatternPosition = (matchStart ? -1 : 0);
+	int wildcardUrlPosition = position;
+
+	while (true)
+	{
+		if (patternPosition == patternLength)
+		{
+			if (!matchEnd || urlPosition == urlLength)
 			{
-				isBlocked = true;
+				return true;
 			}
 		}
+		else if (urlPosition == urlLength)
+		{
+			while (patternPosition < patternLength && (pattern.at(patternPosition) == QLatin1Char('*') || pattern.at(patternPosition) == QLatin1Char('^')))
+			{
+				++patternPosition;
+			}
+
+			return (patternPosition == patternLength);
+		}
+		else if (pattern.at(patternPosition) == QLatin1Char('*'))
+		{
+			++patternPosition;
+
+			wildcardPatternPosition = patternPosition;
+			wildcardUrlPosition = urlPosition;
+
+			continue;
+		}
+		else if ((pattern.at(patternPosition) == QLatin1Char('^')) ? isSeparator(url.at(urlPosition)) : (pattern.at(patternPosition) == url.at(urlPosition)))
+		{
+			++patternPosition;
+			++urlPosition;
+
+			continue;
+		}
 
-		if (isBlocked)
+		if (wildcardPatternPosition < 0 || wildcardUrlPosition >= urlLength)
 		{
-			isBlocked = !rule->isException;
+			return false;
 		}
 
-		resolveRuleOptions(rule, request, isBlocked);
+		++wildcardUrlPosition;
+
+		patternPosition = wildcardPatternPosition;
+		urlPosition = wildcardUrlPosition;
 	}
 
-	return isBlocked;
+	return false;
+}
+
+bool ContentBlockingProfile::isSeparator(QChar character)
+{
+	return !(character.isLetterOrNumber() || character == QLatin1Char('_') || character == QLatin1Char('-') || character == QLatin1Char('.') || character == QLatin1Char('%'));
+}
+
+bool ContentBlockingProfile::checkRuleMatch(const ContentBlockingRule &rule, const RequestInformation &information, int position)
+{
+	return (checkRulePattern(rule, information.url, position, information.hostStart, information.hostEnd) && checkRuleOptions(rule, information.options, information.baseHost));
 }
 
 bool ContentBlockingProfile::isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl)
 {
-	if (!m_wasLoaded)
+	const QSharedPointer<const RuleSet> ruleSet = getRuleSet();
+	const QString url = request.url().url();
+	RequestInformation information;
+	bool hasInformation = false;
+	bool isBlocked = false;
+
+	if (!ruleSet->domainRules.isEmpty())
 	{
-		if (!loadRules())
+		const QString reversedHost = getReversedHost(request.url().host());
+
+		for (int i = 1; i <= reversedHost.length(); ++i)
 		{
-			return false;
+			if (i < reversedHost.length() && reversedHost.at(i) != QLatin1Char('.'))
+			{
+				continue;
+			}
+
+			const QString domain = reversedHost.left(i);
+			QMultiHash<QString, int>::const_iterator iterator = ruleSet->domainRules.constFind(domain);
+
+			while (iterator != ruleSet->domainRules.constEnd() && iterator.key() == domain)
+			{
+				const ContentBlockingRule &rule = ruleSet->rules.at(iterator.value());
+
+				if (!hasInformation)
+				{
+					information = getRequestInformation(request, url, baseUrl);
+					hasInformation = true;
+				}
+
+				if (checkRuleOptions(rule, information.options, information.baseHost))
+				{
+					if (rule.isException)
+					{
+						return false;
+					}
+
+					isBlocked = true;
+				}
+
+				++iterator;
+			}
 		}
 	}
 
-	const QString url = request.url().url();
-	const int urlLenght = url.length();
+// domain rule already blocks request, only exception rules can change that
+	const QVector<ContentBlockingMatcher::Match> matches = (isBlocked ? ruleSet->exceptionsMatcher : ruleSet->matcher).match(url);
 
-	m_baseUrl = baseUrl;
+	if (matches.isEmpty())
+	{
+		return isBlocked;
+	}
 
-	for (int i = 0; i < urlLenght; ++i)
+	if (!hasInformation)
 	{
-		const QString testString = url.right(urlLenght - i);
+		information = getRequestInformation(request, url, baseUrl);
+	}
 
-		if (checkUrlSubstring(testString, request))
+	for (int i = 0; i < matches.count(); ++i)
+	{
+		const ContentBlockingRule &rule = ruleSet->rules.at(matches.at(i).identifier);
+
+		if (!checkRuleMatch(rule, information, matches.at(i).position))
 		{
-			return true;
+			continue;
+		}
+
+		if (rule.isException)
+		{
+			return false;
 		}
+
+		isBlocked = true;
 	}
 
-	return false;
+	return isBlocked;
+}
+
+bool ContentBlockingProfile::isReady()
+{
+	getRuleSet();
+
+	QMutexLocker locker(&m_ruleSetMutex);
+
+	return m_isReady;
 }
 
 }
@@ -22,10 +22,14 @@
 #ifndef OTTER_CONTENTBLOCKINGPROFILE_H
 #define OTTER_CONTENTBLOCKINGPROFILE_H
 
+#include "ContentBlockingMatcher.h"
 #include "NetworkManager.h"
 
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
-#include <QtCore/QRegularExpression>
+#include <QtCore/QSharedPointer>
 #include <QtCore/QUrl>
 
 namespace Otter
@@ -59,68 +63,112 @@ public:
 
 	Q_DECLARE_FLAGS(RuleOptions, RuleOption)
 
+	enum RuleMatch
+	{
+		ContainsMatch = 0,
+		StartMatch,
+		EndMatch,
+		ExactMatch
+	};
+
 	struct ContentBlockingRule
 	{
+		QString pattern;
 		QStringList blockedDomains;
 		QStringList allowedDomains;
 		RuleOptions ruleOption;
 		RuleOptions exceptionRuleOption;
+		RuleMatch ruleMatch;
+		int keyPosition;
+		int keyLength;
 		bool isException;
+		bool isWildcard;
 		bool needsDomainCheck;
 	};
 
+	struct RequestInformation
+	{
+		QString url;
+		QString baseHost;
+		RuleOptions options;
+		int hostStart;
+		int hostEnd;
+	};
+
+	struct RuleSet
+	{
+		QString styleSheet;
+		QStringList selectors;
+		QVector<int> genericSelectors;
+		QHash<QString, QVector<int> > domainSelectors;
+		QHash<QString, QVector<int> > domainSelectorExceptions;
+		QVector<ContentBlockingRule> rules;
+		QMultiHash<QString, int> domainRules;
+		ContentBlockingMatcher matcher;
+		ContentBlockingMatcher exceptionsMatcher;
+	};
+
 	explicit ContentBlockingProfile(const QString &path, QObject *parent = NULL);
+	~ContentBlockingProfile();
 
-	QString getStyleSheet();
+	QString getStyleSheet(const QString &host = QString());
 	ContentBlockingInformation getInformation() const;
-	QMultiHash<QString, QString> getStyleSheetWhiteList();
-	QMultiHash<QString, QString> getStyleSheetBlackList();
+	QSharedPointer<const RuleSet> getRuleSet();
+	static RequestInformation getRequestInformation(const QNetworkRequest &request, const QString &url, const QUrl &baseUrl);
+	static RuleOptions getResourceType(const QNetworkRequest &request, const QString &url);
+	static QString getDomainRuleKey(const ContentBlockingRule &rule);
+	static QString getReversedHost(const QString &host);
+	static bool checkRuleMatch(const ContentBlockingRule &rule, const RequestInformation &information, int position);
+	static bool checkRuleOptions(const ContentBlockingRule &rule, RuleOptions requestOptions, const QString &baseHost);
 	bool isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl);
+	bool isReady();
 
 protected:
-	struct Node
-	{
-		QChar value;
-		ContentBlockingRule *rule;
-		QVarLengthArray<Node*, 5> children;
-
-		Node() : value(0), rule(NULL) {}
-	};
-
-	void load(bool onlyHeader = false);
-	void parseRuleLine(QString line);
-	void resolveRuleOptions(ContentBlockingRule *rule, const QNetworkRequest &request, bool &isBlocked);
-	void parseStyleSheetRule(const QStringList &line, QMultiHash<QString, QString> &list);
-	void addRule(ContentBlockingRule *rule, const QString &ruleString);
-	void deleteNode(Node *node);
+	void load();
+	void saveCache(const RuleSet *ruleSet, qint64 sourceSize, qint64 sourceModified, const QByteArray &sourceChecksum);
+	void saveUpdate(const QByteArray &data);
+	QString getCachePath() const;
+	QByteArray getChecksum() const;
+	QSharedPointer<RuleSet> loadRules();
+	bool loadCache(RuleSet *ruleSet) const;
+	static void parseRuleLine(QString line, RuleSet *ruleSet, QHash<QString, int> &selectors);
+	static void parseStyleSheetRule(const QString &domainList, const QString &selector, bool isException, RuleSet *ruleSet, QHash<QString, int> &selectors);
+	static QString createStyleSheet(const QStringList &selectors, const QVector<int> &identifiers, const QVector<int> &exceptions);
+	static bool checkSelectors(const QVector<int> &identifiers, int amount);
+	static bool isValidSelector(const QString &selector);
+	static bool resolveDomainExceptions(const QString &host, const QStringList &ruleList);
+	static bool checkRulePattern(const ContentBlockingRule &rule, const QString &url, int position, int hostStart, int hostEnd);
+	static bool matchWildcard(const QString &pattern, const QString &url, int position, bool matchStart, bool matchEnd);
+	static bool isSeparator(QChar character);
+
+protected slots:
 	void downloadUpdate();
-	bool loadRules();
-	bool resolveDomainExceptions(const QString &url, const QStringList &ruleList);
-	bool checkUrlSubstring(const QString &subString, const QNetworkRequest &request);
-	bool checkRuleMatch(ContentBlockingRule *rule, const QNetworkRequest &request);
+	void loadRuleSet();
 
 private slots:
 	void updateDownloaded(QNetworkReply *reply);
+	void ruleSetLoaded();
+	void handleCacheError(const QString &error);
 
 private:
-	Node *m_root;
 	QNetworkReply *m_networkReply;
-	QString m_styleSheet;
-	QString m_currentRule;
-	QUrl m_baseUrl;
-	QRegularExpression m_domainExpression;
+	QFutureWatcher<QSharedPointer<RuleSet> > *m_ruleSetWatcher;
 	ContentBlockingInformation m_information;
-	QStringList m_requestSubdomainList;
-	QMultiHash<QString, QString> m_styleSheetBlackList;
-	QMultiHash<QString, QString> m_styleSheetWhiteList;
+	QSharedPointer<const RuleSet> m_ruleSet;
+	QMutex m_ruleSetMutex;
+	QByteArray m_updateData;
+	QElapsedTimer m_loadTimer;
 	bool m_updateRequested;
+	bool m_needsReload;
 	bool m_isEmpty;
+	bool m_isReady;
 	bool m_wasLoaded;
 
 	static NetworkManager *m_networkManager;
 
 signals:
 	void updateCustomStyleSheets();
+	void profileModified(const QString &profile);
 };
 
 }
@@ -0,0 +1,808 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "HistoryDatabase.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+#include <QtCore/QTimerEvent>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlField>
+
+namespace Otter
+{
+
+HistoryDatabase::HistoryDatabase(QObject *parent) : QObject(parent),
+	m_cleanupExcess(-1),
+	m_cleanupLimit(0),
+	m_cleanupTimer(0),
+	m_cleanupTimestamp(0),
+	m_hasSearchIndex(false),
+	m_isIncrementalVacuum(false)
+{
+}
+
+void HistoryDatabase::open(const QString &path, const QString &journalMode)
+{
+	m_statements.clear();
+
+	QSqlDatabase database = QSqlDatabase::addDatabase(QLatin1String("QSQLITE"), QLatin1String("browsingHistory"));
+	database.setDatabaseName(path);
+	database.open();
+	database.exec(QStringLiteral("PRAGMA journal_mode = %1;").arg(journalMode));
+
+	m_statements.setConnection(QLatin1String("browsingHistory"));
+
+	if (!database.tables().contains(QLatin1String("visits")))
+	{
+		QFile file(QLatin1String(":/schemas/browsingHistory.sql"));
+		file.open(QIODevice::ReadOnly);
+
+		QTextStream stream(&file);
+
+		while (!stream.atEnd())
+		{
+			database.exec(stream.readLine());
+		}
+	}
+
+	QSqlQuery query(database);
+	query.exec(QLatin1String("PRAGMA user_version;"));
+
+	const int version = (query.next() ? query.value(0).toInt() : 0);
+
+	query.finish();
+
+	if (version < 5)
+	{
+		upgradeSchema(version);
+	}
+
+	m_hasSearchIndex = database.tables().contains(QLatin1String("visits_search"));
+
+// rebuild switching mode of old database could fail, then pages can not be released step by step and waiting for them would never end
+	QSqlQuery vacuumQuery(database);
+	vacuumQuery.exec(QLatin1String("PRAGMA auto_vacuum;"));
+
+	m_isIncrementalVacuum = (vacuumQuery.next() && vacuumQuery.value(0).toInt() == 2);
+}
+
+void HistoryDatabase::upgradeSchema(int version)
+{
+	QSqlDatabase database = getDatabase();
+	database.transaction();
+
+	if (version < 2)
+	{
+		database.exec(QLatin1String("ALTER TABLE \"locations\" ADD COLUMN \"visits\" INTEGER NOT NULL DEFAULT 0;"));
+		database.exec(QLatin1String("UPDATE \"locations\" SET \"visits\" = (SELECT COUNT(*) FROM \"visits\" WHERE \"visits\".\"location\" = \"locations\".\"id\");"));
+		database.exec(QLatin1String("CREATE INDEX IF NOT EXISTS \"visits_time\" ON \"visits\" (\"time\");"));
+		database.exec(QLatin1String("CREATE INDEX IF NOT EXISTS \"visits_location\" ON \"visits\" (\"location\");"));
+		database.exec(QLatin1String("CREATE INDEX IF NOT EXISTS \"visits_icon\" ON \"visits\" (\"icon\");"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_insert\" AFTER INSERT ON \"visits\" BEGIN UPDATE \"locations\" SET \"visits\" = (\"visits\" + 1) WHERE \"id\" = NEW.\"location\"; END;"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_delete\" AFTER DELETE ON \"visits\" BEGIN UPDATE \"locations\" SET \"visits\" = (\"visits\" - 1) WHERE \"id\" = OLD.\"location\"; END;"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_update\" AFTER UPDATE OF \"location\" ON \"visits\" WHEN NEW.\"location\" <> OLD.\"location\" BEGIN UPDATE \"locations\" SET \"visits\" = (\"visits\" - 1) WHERE \"id\" = OLD.\"location\"; UPDATE \"locations\" SET \"visits\" = (\"visits\" + 1) WHERE \"id\" = NEW.\"location\"; END;"));
+	}
+
+	if (version < 3)
+	{
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_delete_icon\" AFTER DELETE ON \"visits\" WHEN OLD.\"icon\" > 0 BEGIN DELETE FROM \"icons\" WHERE \"id\" = OLD.\"icon\" AND NOT EXISTS(SELECT 1 FROM \"visits\" WHERE \"icon\" = OLD.\"icon\"); END;"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_update_icon\" AFTER UPDATE OF \"icon\" ON \"visits\" WHEN OLD.\"icon\" > 0 AND NEW.\"icon\" <> OLD.\"icon\" BEGIN DELETE FROM \"icons\" WHERE \"id\" = OLD.\"icon\" AND NOT EXISTS(SELECT 1 FROM \"visits\" WHERE \"icon\" = OLD.\"icon\"); END;"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"locations_unused\" AFTER UPDATE OF \"visits\" ON \"locations\" WHEN NEW.\"visits\" <= 0 BEGIN DELETE FROM \"locations\" WHERE \"id\" = NEW.\"id\"; END;"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"locations_delete\" AFTER DELETE ON \"locations\" BEGIN DELETE FROM \"hosts\" WHERE \"id\" = OLD.\"host\" AND NOT EXISTS(SELECT 1 FROM \"locations\" WHERE \"host\" = OLD.\"host\"); END;"));
+		database.exec(QLatin1String("DELETE FROM \"icons\" WHERE \"id\" NOT IN(SELECT DISTINCT \"icon\" FROM \"visits\");"));
+		database.exec(QLatin1String("DELETE FROM \"locations\" WHERE \"visits\" <= 0;"));
+		database.exec(QLatin1String("DELETE FROM \"hosts\" WHERE \"id\" NOT IN(SELECT DISTINCT \"host\" FROM \"locations\");"));
+	}
+
+	if (version < 4)
+	{
+		database.exec(QLatin1String("ALTER TABLE \"icons\" ADD COLUMN \"hash\" INTEGER NOT NULL DEFAULT 0;"));
+
+		QSqlQuery selectQuery(database);
+		selectQuery.setForwardOnly(true);
+		selectQuery.exec(QLatin1String("SELECT \"id\", \"icon\" FROM \"icons\";"));
+
+		QSqlQuery updateQuery(database);
+		updateQuery.prepare(QLatin1String("UPDATE \"icons\" SET \"hash\" = ? WHERE \"id\" = ?;"));
+
+		while (selectQuery.next())
+		{
+			updateQuery.bindValue(0, getHash(selectQuery.value(1).toByteArray()));
+			updateQuery.bindValue(1, selectQuery.value(0));
+			updateQuery.exec();
+		}
+
+		database.exec(QLatin1String("CREATE INDEX IF NOT EXISTS \"icons_hash\" ON \"icons\" (\"hash\");"));
+	}
+
+// full text search is optional, since SQLite library may be built without FTS4 support
+	if (version < 5 && !database.exec(QLatin1String("CREATE VIRTUAL TABLE IF NOT EXISTS \"visits_search\" USING fts4(\"title\", \"url\", prefix=\"2,4\");")).lastError().isValid())
+	{
+		const QString location = QLatin1String("SELECT (\"locations\".\"scheme\" || '://' || IFNULL(\"hosts\".\"host\", '') || IFNULL(\"locations\".\"path\", '')) FROM \"locations\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"locations\".\"id\" = NEW.\"location\"");
+
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_search_insert\" AFTER INSERT ON \"visits\" BEGIN INSERT INTO \"visits_search\" (\"docid\", \"title\", \"url\") VALUES(NEW.\"id\", NEW.\"title\", (") + location + QLatin1String(")); END;"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_search_update\" AFTER UPDATE OF \"title\", \"location\" ON \"visits\" BEGIN UPDATE \"visits_search\" SET \"title\" = NEW.\"title\", \"url\" = (") + location + QLatin1String(") WHERE \"docid\" = NEW.\"id\"; END;"));
+		database.exec(QLatin1String("CREATE TRIGGER IF NOT EXISTS \"visits_search_delete\" AFTER DELETE ON \"visits\" BEGIN DELETE FROM \"visits_search\" WHERE \"docid\" = OLD.\"id\"; END;"));
+		database.exec(QLatin1String("INSERT INTO \"visits_search\" (\"docid\", \"title\", \"url\") SELECT \"visits\".\"id\", \"visits\".\"title\", (\"locations\".\"scheme\" || '://' || IFNULL(\"hosts\".\"host\", '') || IFNULL(\"locations\".\"path\", '')) FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\";"));
+	}
+
+	database.exec(QLatin1String("PRAGMA user_version = 5;"));
+	database.commit();
+
+// auto vacuum mode of existing database can be changed only by rebuilding it, which is done once here
+	if (version < 3)
+	{
+		database.exec(QLatin1String("PRAGMA auto_vacuum = INCREMENTAL;"));
+		database.exec(QLatin1String("VACUUM;"));
+	}
+}
+
+void HistoryDatabase::close()
+{
+	if (!QSqlDatabase::contains(QLatin1String("browsingHistory")))
+	{
+		return;
+	}
+
+	m_statements.clear();
+
+	{
+		QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistory"), false);
+		database.close();
+	}
+
+	QSqlDatabase::removeDatabase(QLatin1String("browsingHistory"));
+}
+
+void HistoryDatabase::clear(const QString &path, const QString &journalMode, int period)
+{
+	const bool wasOpen = QSqlDatabase::contains(QLatin1String("browsingHistory"));
+
+	if (period > 0 && !wasOpen)
+	{
+		open(path, journalMode);
+	}
+
+	if (QSqlDatabase::contains(QLatin1String("browsingHistory")))
+	{
+		QSqlDatabase database = getDatabase();
+
+		if (period > 0)
+		{
+			database.exec(QStringLiteral("DELETE FROM \"visits\" WHERE \"time\" >= %1;").arg(QDateTime::currentDateTime().toTime_t() - (period * 3600)));
+		}
+		else
+		{
+			database.exec(QLatin1String("DELETE FROM \"icons\";"));
+			database.exec(QLatin1String("DELETE FROM \"hosts\";"));
+			database.exec(QLatin1String("DELETE FROM \"locations\";"));
+			database.exec(QLatin1String("DELETE FROM \"visits\";"));
+			database.exec(QLatin1String("VACUUM;"));
+		}
+
+		if (!wasOpen)
+		{
+			close();
+		}
+	}
+	else if (QFile::exists(path))
+	{
+		QFile::remove(path);
+	}
+
+	emit cleared();
+}
+
+void HistoryDatabase::addVisits(const QList<HistoryVisit> &visits, const QList<HistoryNotification> &notifications)
+{
+	QSqlDatabase database = getDatabase();
+
+	if (!database.isValid())
+	{
+		return;
+	}
+
+	QSqlQuery *selectHostQuery = m_statements.getQuery(QLatin1String("SELECT \"id\" FROM \"hosts\" WHERE \"host\" = ?;"));
+	QSqlQuery *insertHostQuery = m_statements.getQuery(QLatin1String("INSERT INTO \"hosts\" (\"host\") VALUES(?);"));
+	QSqlQuery *selectLocationQuery = m_statements.getQuery(QLatin1String("SELECT \"id\" FROM \"locations\" WHERE \"host\" = ? AND \"scheme\" = ? AND \"path\" = ?;"));
+	QSqlQuery *insertLocationQuery = m_statements.getQuery(QLatin1String("INSERT INTO \"locations\" (\"host\", \"scheme\", \"path\") VALUES(?, ?, ?);"));
+	QSqlQuery *selectIconQuery = m_statements.getQuery(QLatin1String("SELECT \"id\" FROM \"icons\" WHERE \"hash\" = ? AND \"icon\" = ?;"));
+	QSqlQuery *insertIconQuery = m_statements.getQuery(QLatin1String("INSERT INTO \"icons\" (\"hash\", \"icon\") VALUES(?, ?);"));
+	QSqlQuery *insertVisitQuery = m_statements.getQuery(QLatin1String("INSERT INTO \"visits\" (\"id\", \"location\", \"icon\", \"title\", \"time\", \"typed\") VALUES(?, ?, ?, ?, ?, ?);"));
+
+	database.transaction();
+
+	for (int i = 0; i < visits.count(); ++i)
+	{
+		const HistoryVisit &visit = visits.at(i);
+		const qint64 host = getIdentifier(selectHostQuery, insertHostQuery, QVariantList() << visit.host);
+		const qint64 location = getIdentifier(selectLocationQuery, insertLocationQuery, QVariantList() << host << visit.scheme << visit.path);
+		const qint64 icon = (visit.icon.isEmpty() ? 0 : getIdentifier(selectIconQuery, insertIconQuery, QVariantList() << visit.iconHash << visit.icon));
+
+		m_statements.exec(insertVisitQuery, QVariantList() << visit.identifier << location << icon << visit.title << visit.time << visit.typed);
+	}
+
+	database.commit();
+
+// records are attached here, so views can be updated without querying database again from main thread
+	QList<HistoryNotification> readyNotifications(notifications);
+
+	for (int i = 0; i < readyNotifications.count(); ++i)
+	{
+		readyNotifications[i].record = getEntry(readyNotifications.at(i).entry);
+	}
+
+	emit notificationsReady(readyNotifications);
+}
+
+void HistoryDatabase::updateVisit(qint64 entry, const HistoryVisit &visit)
+{
+	QSqlDatabase database = getDatabase();
+
+	if (!database.isValid())
+	{
+		return;
+	}
+
+	qint64 icon = 0;
+
+	if (!visit.icon.isEmpty())
+	{
+		icon = getIdentifier(m_statements.getQuery(QLatin1String("SELECT \"id\" FROM \"icons\" WHERE \"hash\" = ? AND \"icon\" = ?;")), m_statements.getQuery(QLatin1String("INSERT INTO \"icons\" (\"hash\", \"icon\") VALUES(?, ?);")), QVariantList() << visit.iconHash << visit.icon);
+	}
+
+	const qint64 host = getIdentifier(m_statements.getQuery(QLatin1String("SELECT \"id\" FROM \"hosts\" WHERE \"host\" = ?;")), m_statements.getQuery(QLatin1String("INSERT INTO \"hosts\" (\"host\") VALUES(?);")), QVariantList() << visit.host);
+	const qint64 location = getIdentifier(m_statements.getQuery(QLatin1String("SELECT \"id\" FROM \"locations\" WHERE \"host\" = ? AND \"scheme\" = ? AND \"path\" = ?;")), m_statements.getQuery(QLatin1String("INSERT INTO \"locations\" (\"host\", \"scheme\", \"path\") VALUES(?, ?, ?);")), QVariantList() << host << visit.scheme << visit.path);
+	QSqlQuery *query = m_statements.getQuery(QLatin1String("UPDATE \"visits\" SET \"location\" = ?, \"icon\" = ?, \"title\" = ? WHERE \"id\" = ?;"));
+
+	if (m_statements.exec(query, QVariantList() << location << icon << visit.title << entry) && query->numRowsAffected() > 0)
+	{
+		HistoryNotification notification;
+		notification.record = getEntry(entry);
+		notification.entry = entry;
+		notification.type = HistoryNotification::UpdatedNotification;
+
+		emit notificationsReady(QList<HistoryNotification>() << notification);
+	}
+}
+
+void HistoryDatabase::removeVisits(const QList<qint64> &entries)
+{
+	QSqlDatabase database = getDatabase();
+
+	if (!database.isValid())
+	{
+		return;
+	}
+
+	QList<qint64> identifiers;
+
+	for (int i = 0; i < entries.count(); ++i)
+	{
+		if (entries.at(i) >= 0)
+		{
+			identifiers.append(entries.at(i));
+		}
+	}
+
+	if (identifiers.isEmpty())
+	{
+		return;
+	}
+
+	if (m_statements.execBatch(QLatin1String("DELETE FROM \"visits\" WHERE \"id\" IN(%1);"), identifiers) > 0)
+	{
+		QList<HistoryNotification> notifications;
+
+		for (int i = 0; i < entries.count(); ++i)
+		{
+			HistoryNotification notification;
+			notification.entry = entries.at(i);
+			notification.type = HistoryNotification::RemovedNotification;
+
+			notifications.append(notification);
+		}
+
+		emit notificationsReady(notifications);
+	}
+}
+
+void HistoryDatabase::removeHostVisits(const QString &host)
+{
+	QSqlDatabase database = getDatabase();
+
+	if (!database.isValid())
+	{
+		return;
+	}
+
+	QList<qint64> entries;
+	QSqlQuery *query = m_statements.getQuery(QLatin1String("SELECT \"visits\".\"id\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"hosts\".\"host\" = ?;"));
+
+	if (m_statements.exec(query, QVariantList() << host))
+	{
+		while (query->next())
+		{
+			entries.append(query->value(0).toLongLong());
+		}
+
+		query->finish();
+	}
+
+	removeVisits(entries);
+}
+
+void HistoryDatabase::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() != m_cleanupTimer)
+	{
+		return;
+	}
+
+	killTimer(m_cleanupTimer);
+
+	m_cleanupTimer = 0;
+
+	QSqlDatabase database = getDatabase();
+
+	if (!database.isValid())
+	{
+		m_cleanupExcess = -1;
+		m_cleanupTimestamp = 0;
+
+		return;
+	}
+
+// amount of visits over limit is counted once when cleanup starts and then counted down by each step
+	if (m_cleanupExcess < 0)
+	{
+		QSqlQuery *amountQuery = m_statements.getQuery(QLatin1String("SELECT COUNT(*) FROM \"visits\";"));
+
+		m_cleanupExcess = ((m_statements.exec(amountQuery) && amountQuery->next()) ? qMax(0, (amountQuery->value(0).toInt() - m_cleanupLimit)) : 0);
+
+		if (amountQuery)
+		{
+			amountQuery->finish();
+		}
+	}
+
+// each step removes limited amount of visits and releases limited amount of pages, so other queries are not starved
+	bool needsCleanup = false;
+
+	if (m_cleanupExcess > 0 || m_cleanupTimestamp > 0)
+	{
+		const bool isRemovingExcess = (m_cleanupExcess > 0);
+		const int limit = (isRemovingExcess ? qMin(500, m_cleanupExcess) : 500);
+		QList<qint64> entries;
+		QSqlQuery *query = (isRemovingExcess ? m_statements.getQuery(QLatin1String("SELECT \"visits\".\"id\" FROM \"visits\" ORDER BY \"visits\".\"time\" ASC LIMIT ?;")) : m_statements.getQuery(QLatin1String("SELECT \"visits\".\"id\" FROM \"visits\" WHERE \"visits\".\"time\" <= ? ORDER BY \"visits\".\"time\" ASC LIMIT ?;")));
+
+		if (m_statements.exec(query, (isRemovingExcess ? (QVariantList() << limit) : (QVariantList() << m_cleanupTimestamp << limit))))
+		{
+			while (query->next())
+			{
+				entries.append(query->value(0).toLongLong());
+			}
+
+			query->finish();
+		}
+
+		if (isRemovingExcess)
+		{
+			m_cleanupExcess = ((entries.count() < limit) ? 0 : (m_cleanupExcess - entries.count()));
+
+			needsCleanup = true;
+		}
+		else if (entries.count() == limit)
+		{
+			needsCleanup = true;
+		}
+		else
+		{
+			m_cleanupTimestamp = 0;
+		}
+
+		database.transaction();
+
+		removeVisits(entries);
+
+		database.commit();
+	}
+
+	if (m_isIncrementalVacuum)
+	{
+		database.exec(QLatin1String("PRAGMA incremental_vacuum(256);"));
+
+		QSqlQuery pagesQuery(database);
+		pagesQuery.exec(QLatin1String("PRAGMA freelist_count;"));
+
+		if (pagesQuery.next() && pagesQuery.value(0).toInt() > 0)
+		{
+			needsCleanup = true;
+		}
+	}
+
+	if (needsCleanup)
+	{
+		m_cleanupTimer = startTimer(250);
+	}
+}
+
+void HistoryDatabase::scheduleCleanup()
+{
+	if (m_cleanupTimer == 0)
+	{
+		m_cleanupTimer = startTimer(0);
+	}
+}
+
+void HistoryDatabase::removeOldVisits(uint timestamp, int limit)
+{
+	m_cleanupTimestamp = qMax(m_cleanupTimestamp, timestamp);
+	m_cleanupExcess = -1;
+	m_cleanupLimit = limit;
+
+	scheduleCleanup();
+}
+
+void HistoryDatabase::cleanup(int limit)
+{
+	m_cleanupExcess = -1;
+	m_cleanupLimit = limit;
+
+	scheduleCleanup();
+}
+
+void HistoryDatabase::loadEntries(int request, uint start, uint end, uint lastTime, qint64 lastEntry, int limit)
+{
+	QList<HistoryRecord> entries;
+	QSqlDatabase database = getDatabase();
+
+	if (database.isValid())
+	{
+		QStringList conditions;
+		QVariantList values;
+
+		if (start > 0)
+		{
+			conditions.append(QLatin1String("\"visits\".\"time\" >= ?"));
+			values.append(start);
+		}
+
+		if (end > 0)
+		{
+			conditions.append(QLatin1String("\"visits\".\"time\" < ?"));
+			values.append(end);
+		}
+
+// continues after last entry of previous page, so entries added in the meantime do not shift pages
+		if (lastEntry >= 0)
+		{
+			conditions.append(QLatin1String("(\"visits\".\"time\" < ? OR (\"visits\".\"time\" = ? AND \"visits\".\"id\" < ?))"));
+			values << lastTime << lastTime << lastEntry;
+		}
+
+// negative limit means no limit in SQLite, so single statement serves each combination of conditions
+		values.append((limit > 0) ? limit : -1);
+
+		QSqlQuery *query = m_statements.getQuery(getEntriesQuery() + (conditions.isEmpty() ? QString() : QLatin1String(" WHERE ") + conditions.join(QLatin1String(" AND "))) + QLatin1String(" ORDER BY \"visits\".\"time\" DESC, \"visits\".\"id\" DESC LIMIT ?;"));
+
+		if (m_statements.exec(query, values))
+		{
+			while (query->next())
+			{
+				entries.append(getRecord(query->record()));
+			}
+
+			query->finish();
+		}
+	}
+
+	emit entriesLoaded(request, entries);
+}
+
+void HistoryDatabase::searchEntries(int request, const QString &text, int limit, bool isRanked)
+{
+	QList<HistoryRecord> entries;
+	QSqlDatabase database = getDatabase();
+
+	if (database.isValid())
+	{
+// ranked search is done for address field, which needs one record per location and no icons
+		const QString select = (isRanked ? getLocationsQuery() : getEntriesQuery());
+		const QString order = (isRanked ? QLatin1String(" GROUP BY \"locations\".\"id\" ORDER BY \"locations\".\"visits\" DESC, \"time\" DESC LIMIT ?;") : QLatin1String(" ORDER BY \"visits\".\"time\" DESC, \"visits\".\"id\" DESC LIMIT ?;"));
+		QSqlQuery *query = NULL;
+		QVariantList values;
+
+		if (m_hasSearchIndex)
+		{
+			const QStringList words = text.split(QRegularExpression(QLatin1String("\\W+"), QRegularExpression::UseUnicodePropertiesOption), QString::SkipEmptyParts);
+			QStringList tokens;
+
+			for (int i = 0; i < words.count(); ++i)
+			{
+				tokens.append(QLatin1Char('"') + words.at(i) + QLatin1String("*\""));
+			}
+
+			if (tokens.isEmpty())
+			{
+				emit entriesLoaded(request, entries);
+
+				return;
+			}
+
+			query = m_statements.getQuery(select + QLatin1String(" WHERE \"visits\".\"id\" IN(SELECT \"docid\" FROM \"visits_search\" WHERE \"visits_search\" MATCH ?)") + order);
+			values << tokens.join(QLatin1Char(' '));
+		}
+		else
+		{
+			const QString pattern = (QLatin1Char('%') + text + QLatin1Char('%'));
+
+			query = m_statements.getQuery(select + QLatin1String(" WHERE \"visits\".\"title\" LIKE ? OR \"hosts\".\"host\" LIKE ? OR \"locations\".\"path\" LIKE ?") + order);
+			values << pattern << pattern << pattern;
+		}
+
+		values.append((limit > 0) ? limit : -1);
+
+		if (m_statements.exec(query, values))
+		{
+			while (query->next())
+			{
+				entries.append(getRecord(query->record()));
+			}
+
+			query->finish();
+		}
+	}
+
+	emit entriesLoaded(request, entries);
+}
+
+void HistoryDatabase::loadFrequentEntries(int request, int limit)
+{
+	QList<HistoryRecord> entries;
+	QSqlDatabase database = getDatabase();
+
+	if (database.isValid())
+	{
+		QSqlQuery *query = m_statements.getQuery(getLocationsQuery() + QLatin1String(" GROUP BY \"locations\".\"id\" ORDER BY \"locations\".\"visits\" DESC, \"time\" DESC LIMIT ?;"));
+
+		if (m_statements.exec(query, QVariantList() << limit))
+		{
+			while (query->next())
+			{
+				entries.append(getRecord(query->record()));
+			}
+
+			query->finish();
+		}
+	}
+
+	emit entriesLoaded(request, entries);
+}
+
+void HistoryDatabase::loadLocations()
+{
+	QSqlDatabase database = getDatabase();
+	int amount = 0;
+
+	if (database.isValid())
+	{
+		QSqlQuery countQuery(database);
+		countQuery.exec(QLatin1String("SELECT COUNT(*) FROM \"locations\";"));
+
+		if (countQuery.next())
+		{
+			amount = countQuery.value(0).toInt();
+		}
+	}
+
+// about ten bits per location keep false positives near one percent, after room for quarter more is used up it is rebuilt
+	QBitArray filter(qMax(8192, ((amount * 25) / 2)));
+
+	if (database.isValid())
+	{
+		QSqlQuery query(database);
+		query.setForwardOnly(true);
+		query.exec(QLatin1String("SELECT \"hosts\".\"host\", \"locations\".\"scheme\", \"locations\".\"path\" FROM \"locations\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\";"));
+
+		while (query.next())
+		{
+			addLocationHash(&filter, getLocationHash(query.value(0).toString(), query.value(1).toString(), query.value(2).toString()));
+		}
+	}
+
+	emit locationsLoaded(filter);
+}
+
+void HistoryDatabase::addLocationHash(QBitArray *filter, qint64 hash)
+{
+	const quint32 first = static_cast<quint32>(hash);
+	const quint32 second = static_cast<quint32>(static_cast<quint64>(hash) >> 32);
+
+	for (int i = 0; i < 7; ++i)
+	{
+		filter->setBit((first + (i * second)) % filter->size());
+	}
+}
+
+QSqlDatabase HistoryDatabase::getDatabase() const
+{
+	if (!QSqlDatabase::contains(QLatin1String("browsingHistory")))
+	{
+		return QSqlDatabase();
+	}
+
+	return QSqlDatabase::database(QLatin1String("browsingHistory"));
+}
+
+HistoryRecord HistoryDatabase::getRecord(const QSqlRecord &record)
+{
+	if (record.isEmpty())
+	{
+		return HistoryRecord();
+	}
+
+	HistoryRecord historyRecord;
+	historyRecord.url = QUrl(record.field(QLatin1String("path")).value().toString());
+	historyRecord.url.setHost(record.field(QLatin1String("host")).value().toString());
+	historyRecord.url.setScheme(record.field(QLatin1String("scheme")).value().toString());
+	historyRecord.title = record.field(QLatin1String("title")).value().toString();
+	historyRecord.time = QDateTime::fromTime_t(record.field(QLatin1String("time")).value().toInt(), Qt::LocalTime);
+	historyRecord.icon = record.field(QLatin1String("icon")).value().toByteArray();
+	historyRecord.identifier = record.field(QLatin1String("id")).value().toLongLong();
+	historyRecord.visits = record.field(QLatin1String("visits")).value().toInt();
+	historyRecord.typed = record.field(QLatin1String("typed")).value().toBool();
+
+	return historyRecord;
+}
+
+HistoryRecord HistoryDatabase::getEntry(qint64 entry)
+{
+	QSqlDatabase database = getDatabase();
+
+	if (!database.isValid())
+	{
+		return HistoryRecord();
+	}
+
+	HistoryRecord record;
+	QSqlQuery *query = m_statements.getQuery(getEntriesQuery() + QLatin1String(" WHERE \"visits\".\"id\" = ?;"));
+
+	if (m_statements.exec(query, QVariantList() << entry))
+	{
+		if (query->next())
+		{
+			record = getRecord(query->record());
+		}
+
+		query->finish();
+	}
+
+	return record;
+}
+
+qint64 HistoryDatabase::getIdentifier(QSqlQuery *selectQuery, QSqlQuery *insertQuery, const QVariantList &values)
+{
+	if (m_statements.exec(selectQuery, values) && selectQuery->next())
+	{
+		const qint64 identifier = selectQuery->value(0).toLongLong();
+
+		selectQuery->finish();
+
+		return identifier;
+	}
+
+	if (selectQuery)
+	{
+		selectQuery->finish();
+	}
+
+	return (m_statements.exec(insertQuery, values) ? insertQuery->lastInsertId().toLongLong() : 0);
+}
+
+qint64 HistoryDatabase::getHash(const QByteArray &data)
+{
+// FNV-1a, stored in database so it has to be stable between sessions and platforms
+	quint64 hash = Q_UINT64_C(14695981039346656037);
+
+	for (int i = 0; i < data.size(); ++i)
+	{
+		hash ^= static_cast<uchar>(data.at(i));
+		hash *= Q_UINT64_C(1099511628211);
+	}
+
+	return static_cast<qint64>(hash);
+}
+
+qint64 HistoryDatabase::getLocationHash(const QString &host, const QString &scheme, const QString &path)
+{
+	return getHash(QString(host + QLatin1Char('\n') + scheme + QLatin1Char('\n') + path).toUtf8());
+}
+
+void HistoryDatabase::loadEntry(qint64 entry)
+{
+	emit entryLoaded(entry, getEntry(entry));
+}
+
+void HistoryDatabase::loadLastIdentifier()
+{
+	emit lastIdentifierLoaded(getLastIdentifier());
+}
+
+qint64 HistoryDatabase::getLastIdentifier()
+{
+	QSqlDatabase database = getDatabase();
+
+	if (!database.isValid())
+	{
+		return 0;
+	}
+
+	qint64 identifier = 0;
+	QSqlQuery *query = m_statements.getQuery(QLatin1String("SELECT MAX(\"id\") FROM \"visits\";"));
+
+	if (m_statements.exec(query))
+	{
+		if (query->next())
+		{
+			identifier = query->value(0).toLongLong();
+		}
+
+		query->finish();
+	}
+
+	return identifier;
+}
+
+QList<SqlStatementCache::StatementStatistics> HistoryDatabase::getStatementStatistics() const
+{
+	return m_statements.getStatistics();
+}
+
+QString HistoryDatabase::getEntriesQuery()
+{
+	return QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"icons\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\", \"locations\".\"visits\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" LEFT JOIN \"icons\" ON \"visits\".\"icon\" = \"icons\".\"id\"");
+}
+
+QString HistoryDatabase::getLocationsQuery()
+{
+// used with grouping by location, bare columns are then taken from its most recent visit
+	return QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", MAX(\"visits\".\"time\") AS \"time\", MAX(\"visits\".\"typed\") AS \"typed\", \"locations\".\"visits\" FROM \"locations\" INNER JOIN \"visits\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\"");
+}
+
+bool HistoryDatabase::checkLocationHash(const QBitArray &filter, qint64 hash)
+{
+	const quint32 first = static_cast<quint32>(hash);
+	const quint32 second = static_cast<quint32>(static_cast<quint64>(hash) >> 32);
+
+	for (int i = 0; i < 7; ++i)
+	{
+		if (!filter.testBit((first + (i * second)) % filter.size()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
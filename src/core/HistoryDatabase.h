@@ -0,0 +1,151 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_HISTORYDATABASE_H
+#define OTTER_HISTORYDATABASE_H
+
+#include "SqlStatementCache.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QBitArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QMetaType>
+#include <QtCore/QUrl>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlRecord>
+
+namespace Otter
+{
+
+struct HistoryVisit
+{
+	QString host;
+	QString scheme;
+	QString path;
+	QString title;
+	QByteArray icon;
+	qint64 iconHash;
+	qint64 identifier;
+	uint time;
+	bool typed;
+
+	HistoryVisit() : iconHash(0), identifier(-1), time(0), typed(false) {}
+};
+
+struct HistoryRecord
+{
+	QUrl url;
+	QString title;
+	QDateTime time;
+	QByteArray icon;
+	qint64 identifier;
+	int visits;
+	bool typed;
+
+	HistoryRecord() : identifier(-1), visits(0), typed(false) {}
+};
+
+struct HistoryNotification
+{
+	enum NotificationType
+	{
+		AddedNotification = 0,
+		UpdatedNotification = 1,
+		RemovedNotification = 2
+	};
+
+	HistoryRecord record;
+	qint64 entry;
+	NotificationType type;
+
+	HistoryNotification() : entry(-1), type(AddedNotification) {}
+};
+
+class HistoryDatabase : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit HistoryDatabase(QObject *parent = NULL);
+
+public slots:
+	void open(const QString &path, const QString &journalMode);
+	void close();
+	void clear(const QString &path, const QString &journalMode, int period);
+	void addVisits(const QList<HistoryVisit> &visits, const QList<HistoryNotification> &notifications);
+	void updateVisit(qint64 entry, const HistoryVisit &visit);
+	void removeVisits(const QList<qint64> &entries);
+	void removeHostVisits(const QString &host);
+	void removeOldVisits(uint timestamp, int limit);
+	void cleanup(int limit);
+	void loadEntries(int request, uint start, uint end, uint lastTime, qint64 lastEntry, int limit);
+	void loadEntry(qint64 entry);
+	void loadLastIdentifier();
+	qint64 getLastIdentifier();
+	void searchEntries(int request, const QString &text, int limit, bool isRanked);
+	void loadFrequentEntries(int request, int limit);
+	void loadLocations();
+
+public:
+	QList<SqlStatementCache::StatementStatistics> getStatementStatistics() const;
+	static void addLocationHash(QBitArray *filter, qint64 hash);
+	static qint64 getHash(const QByteArray &data);
+	static qint64 getLocationHash(const QString &host, const QString &scheme, const QString &path);
+	static bool checkLocationHash(const QBitArray &filter, qint64 hash);
+
+protected:
+	void timerEvent(QTimerEvent *event);
+	void scheduleCleanup();
+	void upgradeSchema(int version);
+	QSqlDatabase getDatabase() const;
+	HistoryRecord getEntry(qint64 entry);
+	static HistoryRecord getRecord(const QSqlRecord &record);
+	qint64 getIdentifier(QSqlQuery *selectQuery, QSqlQuery *insertQuery, const QVariantList &values);
+	static QString getEntriesQuery();
+	static QString getLocationsQuery();
+
+private:
+	SqlStatementCache m_statements;
+	int m_cleanupExcess;
+	int m_cleanupLimit;
+	int m_cleanupTimer;
+	uint m_cleanupTimestamp;
+	bool m_hasSearchIndex;
+	bool m_isIncrementalVacuum;
+
+signals:
+	void cleared();
+	void entriesLoaded(int request, const QList<HistoryRecord> &entries);
+	void entryLoaded(qint64 entry, const HistoryRecord &record);
+	void lastIdentifierLoaded(qint64 identifier);
+	void locationsLoaded(const QBitArray &filter);
+	void notificationsReady(const QList<HistoryNotification> &notifications);
+};
+
+}
+
+Q_DECLARE_METATYPE(Otter::HistoryVisit)
+Q_DECLARE_METATYPE(Otter::HistoryRecord)
+Q_DECLARE_METATYPE(Otter::HistoryNotification)
+Q_DECLARE_METATYPE(QList<Otter::HistoryVisit>)
+Q_DECLARE_METATYPE(QList<Otter::HistoryRecord>)
+Q_DECLARE_METATYPE(QList<Otter::HistoryNotification>)
+
+#endif
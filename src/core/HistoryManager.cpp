@@ -22,30 +22,84 @@
 #include "SettingsManager.h"
 
 #include <QtCore/QBuffer>
-#include <QtCore/QFile>
-#include <QtCore/QTextStream>
 #include <QtCore/QTimerEvent>
-#include <QtSql/QSqlDatabase>
-#include <QtSql/QSqlField>
-#include <QtSql/QSqlQuery>
-#include <QtSql/QSqlResult>
+#include <QtGui/QPixmap>
 
 namespace Otter
 {
 
 HistoryManager* HistoryManager::m_instance = NULL;
+QCache<qint64, HistoryEntry> HistoryManager::m_entriesCache(100);
+QCache<qint64, QPair<QByteArray, qint64> > HistoryManager::m_iconsCache(50);
+QBitArray HistoryManager::m_locationsFilter;
+QHash<qint64, qint64> HistoryManager::m_provisionalIdentifiers;
+QSet<qint64> HistoryManager::m_requestedEntries;
+QVector<qint64> HistoryManager::m_pendingLocations;
+QList<HistoryVisit> HistoryManager::m_pendingVisits;
+QList<HistoryNotification> HistoryManager::m_pendingNotifications;
+qint64 HistoryManager::m_lastIdentifier = -1;
+qint64 HistoryManager::m_lastProvisionalIdentifier = -1;
+int HistoryManager::m_addedLocations = 0;
+int HistoryManager::m_lastRequest = 0;
 bool HistoryManager::m_isEnabled = false;
+bool HistoryManager::m_isLoadingLocations = false;
 bool HistoryManager::m_isStoringFavicons = true;
 
 HistoryManager::HistoryManager(QObject *parent) : QObject(parent),
-	m_cleanupTimer(0)
+	m_thread(new QThread(this)),
+	m_database(new HistoryDatabase()),
+	m_cleanupTimer(0),
+	m_flushTimer(0),
+	m_locationsTimer(0)
 {
+	qRegisterMetaType<HistoryVisit>("HistoryVisit");
+	qRegisterMetaType<HistoryRecord>("HistoryRecord");
+	qRegisterMetaType<QList<qint64> >("QList<qint64>");
+	qRegisterMetaType<QList<HistoryVisit> >("QList<HistoryVisit>");
+	qRegisterMetaType<QList<HistoryRecord> >("QList<HistoryRecord>");
+	qRegisterMetaType<QList<HistoryNotification> >("QList<HistoryNotification>");
+
+// all queries are executed by worker thread, so slow disk access or cleanup does not block user interface
+	m_database->moveToThread(m_thread);
+
+	connect(m_thread, SIGNAL(finished()), m_database, SLOT(deleteLater()));
+	connect(m_database, SIGNAL(cleared()), this, SIGNAL(cleared()));
+	connect(m_database, SIGNAL(entriesLoaded(int,QList<HistoryRecord>)), this, SIGNAL(entriesLoaded(int,QList<HistoryRecord>)));
+	connect(m_database, SIGNAL(entryLoaded(qint64,HistoryRecord)), this, SLOT(handleEntryLoaded(qint64,HistoryRecord)));
+	connect(m_database, SIGNAL(lastIdentifierLoaded(qint64)), this, SLOT(handleLastIdentifierLoaded(qint64)));
+	connect(m_database, SIGNAL(locationsLoaded(QBitArray)), this, SLOT(handleLocationsLoaded(QBitArray)));
+	connect(m_database, SIGNAL(notificationsReady(QList<HistoryNotification>)), this, SLOT(handleNotifications(QList<HistoryNotification>)));
+
+	m_thread->start();
+
 	m_dayTimer = startTimer(QTime::currentTime().msecsTo(QTime(23, 59, 59, 999)));
 
 	optionChanged(QLatin1String("History/RememberBrowsing"));
 	optionChanged(QLatin1String("History/StoreFavicons"));
 
-	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString)));
+	SettingsManager::addListener(QLatin1String("Browser/PrivateMode"), this, SLOT(optionChanged(QString)));
+	SettingsManager::addListener(QLatin1String("History/RememberBrowsing"), this, SLOT(optionChanged(QString)));
+	SettingsManager::addListener(QLatin1String("History/StoreFavicons"), this, SLOT(optionChanged(QString)));
+}
+
+HistoryManager::~HistoryManager()
+{
+// visits added before last stored identifier was announced would be lost otherwise
+	if (m_isEnabled && m_lastIdentifier < 0 && !m_pendingVisits.isEmpty())
+	{
+		qint64 identifier = 0;
+
+		QMetaObject::invokeMethod(m_database, "getLastIdentifier", Qt::BlockingQueuedConnection, Q_RETURN_ARG(qint64, identifier));
+
+		handleLastIdentifierLoaded(identifier);
+	}
+
+	flushEntries();
+
+	QMetaObject::invokeMethod(m_database, "close", Qt::BlockingQueuedConnection);
+
+	m_thread->quit();
+	m_thread->wait();
 }
 
 void HistoryManager::createInstance(QObject *parent)
@@ -64,31 +118,27 @@ void HistoryManager::timerEvent(QTimerEvent *event)
 
 		m_cleanupTimer = 0;
 
-		QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistory"));
-
-		if (!database.isValid())
+		if (m_isEnabled)
 		{
-			return;
+			QMetaObject::invokeMethod(m_database, "cleanup", Qt::QueuedConnection, Q_ARG(int, SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt()));
 		}
+	}
+	else if (event->timerId() == m_flushTimer)
+	{
+		flushEntries();
+	}
+	else if (event->timerId() == m_locationsTimer)
+	{
+		killTimer(m_locationsTimer);
 
-		QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-		query.prepare(QLatin1String("SELECT COUNT(*) AS \"amount\" FROM \"visits\";"));
-		query.exec();
+		m_locationsTimer = 0;
 
-		if (query.next())
+		if (m_isEnabled)
 		{
-			const int amount = query.record().field(QLatin1String("amount")).value().toInt();
+			m_isLoadingLocations = true;
 
-			if (amount > SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt())
-			{
-				removeOldEntries();
-			}
+			QMetaObject::invokeMethod(m_database, "loadLocations", Qt::QueuedConnection);
 		}
-
-		database.exec(QLatin1String("DELETE FROM \"icons\" WHERE \"id\" NOT IN(SELECT DISTINCT \"icon\" FROM \"visits\");"));
-		database.exec(QLatin1String("DELETE FROM \"locations\" WHERE \"id\" NOT IN(SELECT DISTINCT \"location\" FROM \"visits\");"));
-		database.exec(QLatin1String("DELETE FROM \"hosts\" WHERE \"id\" NOT IN(SELECT DISTINCT \"host\" FROM \"locations\");"));
-		database.exec(QLatin1String("VACUUM;"));
 	}
 	else if (event->timerId() == m_dayTimer)
 	{
@@ -110,116 +160,225 @@ void HistoryManager::scheduleCleanup()
 	}
 }
 
-void HistoryManager::removeOldEntries(const QDateTime &date)
+void HistoryManager::scheduleFlush()
 {
-	int timestamp = (date.isValid() ? date.toTime_t() : 0);
+	if (m_flushTimer == 0)
+	{
+		m_flushTimer = startTimer(500);
+	}
+}
 
-	if (timestamp == 0)
+void HistoryManager::scheduleLocationsReload()
+{
+	if (m_locationsTimer == 0)
 	{
-		QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-		query.prepare(QStringLiteral("SELECT \"visits\".\"time\" FROM \"visits\" ORDER BY \"visits\".\"time\" DESC LIMIT %1, 1;").arg(SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt()));
-		query.exec();
+		m_locationsTimer = startTimer(5000);
+	}
+}
 
-		if (query.next())
-		{
-			timestamp = query.record().field(QLatin1String("time")).value().toInt();
-		}
+void HistoryManager::flushEntries()
+{
+	if (!m_instance)
+	{
+		return;
+	}
 
-		if (timestamp == 0)
-		{
-			return;
-		}
+	if (m_instance->m_flushTimer != 0)
+	{
+		m_instance->killTimer(m_instance->m_flushTimer);
+
+		m_instance->m_flushTimer = 0;
 	}
 
-	QList<qint64> entries;
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("SELECT \"visits\".\"id\" FROM \"visits\" WHERE \"visits\".\"time\" <= ?;"));
-	query.bindValue(0, timestamp);
-	query.exec();
+// visits with provisional identifiers are kept until last stored identifier is known
+	if (m_pendingNotifications.isEmpty() || (m_isEnabled && m_lastIdentifier < 0))
+	{
+		return;
+	}
+
+	const QList<HistoryVisit> visits = m_pendingVisits;
+	const QList<HistoryNotification> notifications = m_pendingNotifications;
 
-	while (query.next())
+	m_pendingVisits.clear();
+	m_pendingNotifications.clear();
+
+	if (m_isEnabled)
 	{
-		entries.append(query.record().field("id").value().toLongLong());
+		QMetaObject::invokeMethod(m_instance->m_database, "addVisits", Qt::QueuedConnection, Q_ARG(QList<HistoryVisit>, visits), Q_ARG(QList<HistoryNotification>, notifications));
 	}
+}
 
-	removeEntries(entries);
+void HistoryManager::removeOldEntries(const QDateTime &date)
+{
+	if (m_isEnabled)
+	{
+		QMetaObject::invokeMethod(m_database, "removeOldVisits", Qt::QueuedConnection, Q_ARG(uint, (date.isValid() ? date.toTime_t() : 0)), Q_ARG(int, SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt()));
+	}
 }
 
 void HistoryManager::clearHistory(int period)
 {
-	QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistory"));
+	flushEntries();
+
+	m_entriesCache.clear();
 
-	if (period > 0 && !database.isValid())
+	if (period == 0)
 	{
-		database = QSqlDatabase::addDatabase(QLatin1String("QSQLITE"), QLatin1String("browsingHistory"));
-		database.setDatabaseName(SessionsManager::getWritableDataPath(QLatin1String("browsingHistory.sqlite")));
-		database.open();
-		database.exec(QStringLiteral("PRAGMA journal_mode = %1;").arg(SettingsManager::getValue(QLatin1String("Browser/SqliteJournalMode")).toString()));
+		m_locationsFilter.fill(false);
 	}
 
-	const QString path = SessionsManager::getWritableDataPath(QLatin1String("browsingHistory.sqlite"));
+	QMetaObject::invokeMethod(m_instance->m_database, "clear", Qt::QueuedConnection, Q_ARG(QString, SessionsManager::getWritableDataPath(QLatin1String("browsingHistory.sqlite"))), Q_ARG(QString, SettingsManager::getValue(QLatin1String("Browser/SqliteJournalMode")).toString()), Q_ARG(int, period));
+
+	if (period > 0 && m_isEnabled)
+	{
+		m_instance->scheduleCleanup();
+
+		m_isLoadingLocations = true;
+
+		QMetaObject::invokeMethod(m_instance->m_database, "loadLocations", Qt::QueuedConnection);
+	}
+}
 
-	if (database.isValid())
+void HistoryManager::optionChanged(const QString &option)
+{
+	if (option == QLatin1String("History/RememberBrowsing") || option == QLatin1String("Browser/PrivateMode"))
 	{
-		if (period > 0)
+		const bool enabled = (SettingsManager::getValue(QLatin1String("History/RememberBrowsing")).toBool() && !SettingsManager::getValue(QLatin1String("Browser/PrivateMode")).toBool());
+
+		if (enabled && !m_isEnabled)
+		{
+			m_lastIdentifier = -1;
+			m_locationsFilter.clear();
+			m_pendingLocations.clear();
+			m_requestedEntries.clear();
+			m_isLoadingLocations = true;
+
+			QMetaObject::invokeMethod(m_database, "open", Qt::QueuedConnection, Q_ARG(QString, SessionsManager::getWritableDataPath(QLatin1String("browsingHistory.sqlite"))), Q_ARG(QString, SettingsManager::getValue(QLatin1String("Browser/SqliteJournalMode")).toString()));
+			QMetaObject::invokeMethod(m_database, "loadLastIdentifier", Qt::QueuedConnection);
+			QMetaObject::invokeMethod(m_database, "loadLocations", Qt::QueuedConnection);
+		}
+		else if (!enabled && m_isEnabled)
 		{
-			database.exec(QStringLiteral("DELETE FROM \"visits\" WHERE \"time\" >= %1;").arg(QDateTime::currentDateTime().toTime_t() - (period * 3600)));
+			flushEntries();
 
-			m_instance->scheduleCleanup();
+			m_entriesCache.clear();
+
+			QMetaObject::invokeMethod(m_database, "close", Qt::QueuedConnection);
 		}
-		else
+
+		m_isEnabled = enabled;
+	}
+	else if (option == QLatin1String("History/StoreFavicons"))
+	{
+		m_isStoringFavicons = SettingsManager::getValue(option).toBool();
+	}
+}
+
+void HistoryManager::handleEntryLoaded(qint64 entry, const HistoryRecord &record)
+{
+	m_requestedEntries.remove(entry);
+
+	if (!m_isEnabled || record.identifier < 0)
+	{
+		return;
+	}
+
+	m_entriesCache.insert(entry, new HistoryEntry(getEntry(record)));
+
+	emit entryUpdated(entry);
+}
+
+void HistoryManager::handleLastIdentifierLoaded(qint64 identifier)
+{
+	if (!m_isEnabled || m_lastIdentifier >= 0)
+	{
+		return;
+	}
+
+	m_lastIdentifier = identifier;
+
+	for (int i = 0; i < m_pendingVisits.count(); ++i)
+	{
+		if (m_pendingVisits.at(i).identifier < -1)
 		{
-			database.exec(QLatin1String("DELETE FROM \"visits\";"));
-			database.exec(QLatin1String("DELETE FROM \"locations\";"));
-			database.exec(QLatin1String("DELETE FROM \"hosts\";"));
-			database.exec(QLatin1String("DELETE FROM \"icons\";"));
-			database.exec(QLatin1String("VACUUM;"));
+			const qint64 identifier = ++m_lastIdentifier;
+
+			m_provisionalIdentifiers[m_pendingVisits.at(i).identifier] = identifier;
+
+			m_pendingVisits[i].identifier = identifier;
 		}
 	}
-	else if (QFile::exists(path))
+
+	for (int i = 0; i < m_pendingNotifications.count(); ++i)
 	{
-		QFile::remove(path);
+		m_pendingNotifications[i].entry = resolveIdentifier(m_pendingNotifications.at(i).entry);
 	}
 
-	emit m_instance->cleared();
+	flushEntries();
 }
 
-void HistoryManager::optionChanged(const QString &option)
+void HistoryManager::handleLocationsLoaded(const QBitArray &filter)
 {
-	if (option == QLatin1String("History/RememberBrowsing") || option == QLatin1String("Browser/PrivateMode"))
+	m_isLoadingLocations = false;
+
+	if (!m_isEnabled)
 	{
-		const bool enabled = (SettingsManager::getValue(QLatin1String("History/RememberBrowsing")).toBool() && !SettingsManager::getValue(QLatin1String("Browser/PrivateMode")).toBool());
+		return;
+	}
 
-		if (enabled && !m_isEnabled)
+	m_locationsFilter = filter;
+	m_addedLocations = 0;
+
+	for (int i = 0; i < m_pendingLocations.count(); ++i)
+	{
+		HistoryDatabase::addLocationHash(&m_locationsFilter, m_pendingLocations.at(i));
+	}
+
+	m_pendingLocations.clear();
+}
+
+void HistoryManager::handleNotifications(const QList<HistoryNotification> &notifications)
+{
+	bool needsCleanup = false;
+
+	for (int i = 0; i < notifications.count(); ++i)
+	{
+		const HistoryNotification &notification = notifications.at(i);
+
+		if (notification.type == HistoryNotification::RemovedNotification)
 		{
-			QSqlDatabase database = QSqlDatabase::addDatabase(QLatin1String("QSQLITE"), QLatin1String("browsingHistory"));
-			database.setDatabaseName(SessionsManager::getWritableDataPath(QLatin1String("browsingHistory.sqlite")));
-			database.open();
-			database.exec(QStringLiteral("PRAGMA journal_mode = %1;").arg(SettingsManager::getValue(QLatin1String("Browser/SqliteJournalMode")).toString()));
+			m_entriesCache.remove(notification.entry);
 
-			if (!database.tables().contains(QLatin1String("visits")))
-			{
-				QFile file(QLatin1String(":/schemas/browsingHistory.sql"));
-				file.open(QIODevice::ReadOnly);
+			needsCleanup = true;
 
-				QTextStream stream(&file);
+// filter can not forget locations, so it is rebuilt once removals settle down
+			scheduleLocationsReload();
 
-				while (!stream.atEnd())
-				{
-					database.exec(stream.readLine());
-				}
-			}
+			emit entryRemoved(notification.entry);
+
+			continue;
 		}
-		else if (!enabled && m_isEnabled)
+
+		if (notification.record.identifier >= 0)
 		{
-			QSqlDatabase::database(QLatin1String("browsingHistory")).close();
+			m_entriesCache.insert(notification.entry, new HistoryEntry(getEntry(notification.record)));
 		}
 
-		m_isEnabled = enabled;
+		if (notification.type == HistoryNotification::UpdatedNotification)
+		{
+			needsCleanup = true;
+
+			emit entryUpdated(notification.entry);
+		}
+		else
+		{
+			emit entryAdded(notification.entry);
+		}
 	}
-	else if (option == QLatin1String("History/StoreFavicons"))
+
+	if (needsCleanup)
 	{
-		m_isStoringFavicons = SettingsManager::getValue(option).toBool();
+		scheduleCleanup();
 	}
 }
 
@@ -228,26 +387,19 @@ HistoryManager* HistoryManager::getInstance()
 	return m_instance;
 }
 
-HistoryEntry HistoryManager::getEntry(const QSqlRecord &record)
+HistoryEntry HistoryManager::getEntry(const HistoryRecord &record)
 {
-	if (record.isEmpty())
-	{
-		return HistoryEntry();
-	}
-
 	QPixmap pixmap;
-	pixmap.loadFromData(record.field(QLatin1String("icon")).value().toByteArray());
+	pixmap.loadFromData(record.icon);
 
 	HistoryEntry historyEntry;
-	historyEntry.url = QUrl(record.field(QLatin1String("path")).value().toString());
-	historyEntry.url.setHost(record.field(QLatin1String("host")).value().toString());
-	historyEntry.url.setScheme(record.field(QLatin1String("scheme")).value().toString());
-	historyEntry.title = record.field(QLatin1String("title")).value().toString();
-	historyEntry.time = QDateTime::fromTime_t(record.field(QLatin1String("time")).value().toInt(), Qt::LocalTime);
+	historyEntry.url = record.url;
+	historyEntry.title = record.title;
+	historyEntry.time = record.time;
 	historyEntry.icon = QIcon(pixmap);
-	historyEntry.identifier = record.field(QLatin1String("id")).value().toLongLong();
-	historyEntry.visits = record.field(QLatin1String("visits")).value().toInt();
-	historyEntry.typed = record.field(QLatin1String("typed")).value().toBool();
+	historyEntry.identifier = record.identifier;
+	historyEntry.visits = record.visits;
+	historyEntry.typed = record.typed;
 
 	return historyEntry;
 }
@@ -259,150 +411,206 @@ HistoryEntry HistoryManager::getEntry(qint64 entry)
 		return HistoryEntry();
 	}
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"icons\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" LEFT JOIN \"icons\" ON \"visits\".\"icon\" = \"icons\".\"id\" WHERE \"visits\".\"id\" = ?;"));
-	query.bindValue(0, entry);
-	query.exec();
+	const qint64 identifier = resolveIdentifier(entry);
 
-	if (query.first())
+	if (m_entriesCache.contains(identifier))
 	{
-		return getEntry(query.record());
+		return *m_entriesCache.object(identifier);
+	}
+
+// entries which were not announced recently are loaded in background and announced as updated once available
+	if (identifier >= 0 && !m_requestedEntries.contains(identifier))
+	{
+		m_requestedEntries.insert(identifier);
+
+		flushEntries();
+
+		QMetaObject::invokeMethod(m_instance->m_database, "loadEntry", Qt::QueuedConnection, Q_ARG(qint64, identifier));
 	}
 
 	return HistoryEntry();
 }
 
-QList<HistoryEntry> HistoryManager::getEntries(bool typed)
+int HistoryManager::searchEntries(const QString &text, int limit, bool isRanked)
 {
-	QList<HistoryEntry> entries;
+	++m_lastRequest;
 
-	if (!m_isEnabled)
+	flushEntries();
+
+	if (m_isEnabled)
 	{
-		return entries;
+		QMetaObject::invokeMethod(m_instance->m_database, "searchEntries", Qt::QueuedConnection, Q_ARG(int, m_lastRequest), Q_ARG(QString, text), Q_ARG(int, limit), Q_ARG(bool, isRanked));
 	}
-
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"icons\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" LEFT JOIN \"icons\" ON \"visits\".\"icon\" = \"icons\".\"id\"") + (typed ? QLatin1String(" \"visits\".\"typed\" = 1") : QString()) + QLatin1String(" ORDER BY \"visits\".\"time\" DESC;"));
-	query.exec();
-
-	while (query.next())
+	else
 	{
-		entries.append(getEntry(query.record()));
+		QMetaObject::invokeMethod(m_instance, "entriesLoaded", Qt::QueuedConnection, Q_ARG(int, m_lastRequest), Q_ARG(QList<HistoryRecord>, QList<HistoryRecord>()));
 	}
 
-	return entries;
+	return m_lastRequest;
 }
 
-qint64 HistoryManager::getRecord(const QLatin1String &table, const QVariantHash &values, bool canCreate)
+int HistoryManager::requestFrequentEntries(int limit)
 {
-	const QStringList keys = values.keys();
-	QStringList placeholders;
+	++m_lastRequest;
+
+	flushEntries();
 
-	for (int i = 0; i < keys.count(); ++i)
+	if (m_isEnabled)
 	{
-		placeholders.append(QString('?'));
+		QMetaObject::invokeMethod(m_instance->m_database, "loadFrequentEntries", Qt::QueuedConnection, Q_ARG(int, m_lastRequest), Q_ARG(int, limit));
+	}
+	else
+	{
+		QMetaObject::invokeMethod(m_instance, "entriesLoaded", Qt::QueuedConnection, Q_ARG(int, m_lastRequest), Q_ARG(QList<HistoryRecord>, QList<HistoryRecord>()));
 	}
 
-	QSqlQuery selectQuery(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	selectQuery.prepare(QStringLiteral("SELECT \"id\" FROM \"%1\" WHERE \"%2\" = ?;").arg(table).arg(keys.join(QLatin1String("\" = ? AND \""))));
+	return m_lastRequest;
+}
 
-	for (int i = 0; i < keys.count(); ++i)
+int HistoryManager::requestEntries(const QDateTime &start, const QDateTime &end, const QDateTime &lastTime, qint64 lastEntry, int limit)
+{
+	++m_lastRequest;
+
+	flushEntries();
+
+	if (m_isEnabled)
+	{
+		QMetaObject::invokeMethod(m_instance->m_database, "loadEntries", Qt::QueuedConnection, Q_ARG(int, m_lastRequest), Q_ARG(uint, (start.isValid() ? start.toTime_t() : 0)), Q_ARG(uint, (end.isValid() ? end.toTime_t() : 0)), Q_ARG(uint, (lastTime.isValid() ? lastTime.toTime_t() : 0)), Q_ARG(qint64, lastEntry), Q_ARG(int, limit));
+	}
+	else
 	{
-		selectQuery.bindValue(i, values[keys.at(i)]);
+		QMetaObject::invokeMethod(m_instance, "entriesLoaded", Qt::QueuedConnection, Q_ARG(int, m_lastRequest), Q_ARG(QList<HistoryRecord>, QList<HistoryRecord>()));
 	}
 
-	selectQuery.exec();
+	return m_lastRequest;
+}
+
+qint64 HistoryManager::resolveIdentifier(qint64 entry)
+{
+	return ((entry < -1) ? m_provisionalIdentifiers.value(entry, entry) : entry);
+}
 
-	if (selectQuery.first())
+void HistoryManager::setIcon(const QIcon &icon, HistoryVisit *visit)
+{
+	if (!m_isStoringFavicons || icon.isNull())
 	{
-		return selectQuery.record().field(QLatin1String("id")).value().toLongLong();
+		return;
 	}
 
-	if (!canCreate)
+// icons are cached by hash of their raw pixels, so identical icons are not encoded again for every visit
+	const QImage image = icon.pixmap(QSize(16, 16)).toImage();
+	const qint64 key = HistoryDatabase::getHash(QByteArray::fromRawData(reinterpret_cast<const char*>(image.constBits()), image.byteCount()));
+
+	if (!m_iconsCache.contains(key))
 	{
-		return -1;
+		QByteArray data;
+		QBuffer buffer(&data);
+		buffer.open(QIODevice::WriteOnly);
+
+		image.save(&buffer, "PNG");
+
+		m_iconsCache.insert(key, new QPair<QByteArray, qint64>(data, HistoryDatabase::getHash(data)));
 	}
 
-	QSqlQuery insertQuery(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	insertQuery.prepare(QStringLiteral("INSERT INTO \"%1\" (\"%2\") VALUES(%3);").arg(table).arg(keys.join(QLatin1String("\", \""))).arg(placeholders.join(QLatin1String(", "))));
+	const QPair<QByteArray, qint64> *data = m_iconsCache.object(key);
+
+	visit->icon = data->first;
+	visit->iconHash = data->second;
+}
 
-	for (int i = 0; i < keys.count(); ++i)
+void HistoryManager::addLocation(const HistoryVisit &visit)
+{
+	const qint64 hash = HistoryDatabase::getLocationHash(visit.host, visit.scheme, visit.path);
+
+	if (m_locationsFilter.isEmpty() || m_isLoadingLocations)
 	{
-		insertQuery.bindValue(i, values[keys.at(i)]);
+		m_pendingLocations.append(hash);
 	}
 
-	insertQuery.exec();
+	if (!m_locationsFilter.isEmpty() && !HistoryDatabase::checkLocationHash(m_locationsFilter, hash))
+	{
+		HistoryDatabase::addLocationHash(&m_locationsFilter, hash);
 
-	return insertQuery.lastInsertId().toULongLong();
+		++m_addedLocations;
+
+// filter is sized for quarter more locations than it was built with, so it is rebuilt before it gets too dense
+		if (m_instance && m_addedLocations > (m_locationsFilter.size() / 50))
+		{
+			m_instance->scheduleLocationsReload();
+		}
+	}
 }
 
-qint64 HistoryManager::getLocation(const QUrl &url, bool canCreate)
+void HistoryManager::setUrl(const QUrl &url, HistoryVisit *visit)
 {
-	QVariantHash hostsRecord;
-	hostsRecord[QLatin1String("host")] = url.host();
-
 	QUrl simplifiedUrl(url);
 	simplifiedUrl.setScheme(QString());
 	simplifiedUrl.setHost(QString());
 
-	QVariantHash locationsRecord;
-	locationsRecord[QLatin1String("host")] = getRecord(QLatin1String("hosts"), hostsRecord, canCreate);
-	locationsRecord[QLatin1String("scheme")] = url.scheme();
-	locationsRecord[QLatin1String("path")] = simplifiedUrl.toString(QUrl::RemovePassword | QUrl::NormalizePathSegments);
-
-	return getRecord(QLatin1String("locations"), locationsRecord, canCreate);
+	visit->host = url.host();
+	visit->scheme = url.scheme();
+	visit->path = simplifiedUrl.toString(QUrl::RemovePassword | QUrl::NormalizePathSegments);
 }
 
-qint64 HistoryManager::getIcon(const QIcon &icon, bool canCreate)
+qint64 HistoryManager::addEntry(const QUrl &url, const QString &title, const QIcon &icon, bool typed)
 {
-	if (!m_isStoringFavicons)
+	if (!m_isEnabled || !url.isValid() || !SettingsManager::getValue(QLatin1String("History/RememberBrowsing"), url).toBool())
 	{
-		return 0;
+		return -1;
 	}
 
-	QByteArray data;
-	QBuffer buffer(&data);
-	buffer.open(QIODevice::WriteOnly);
+// visits are written in batches, so identifiers are assigned upfront, provisional ones are used until last stored one is known
+	HistoryVisit visit;
+	visit.title = title;
+	visit.identifier = ((m_lastIdentifier < 0) ? --m_lastProvisionalIdentifier : ++m_lastIdentifier);
+	visit.time = QDateTime::currentDateTime().toTime_t();
+	visit.typed = typed;
+
+	setUrl(url, &visit);
+	setIcon(icon, &visit);
+	addLocation(visit);
+
+	HistoryNotification notification;
+	notification.entry = visit.identifier;
+	notification.type = HistoryNotification::AddedNotification;
 
-	icon.pixmap(QSize(16, 16)).save(&buffer, "PNG");
+	m_pendingVisits.append(visit);
+	m_pendingNotifications.append(notification);
 
-	QVariantHash record;
-	record[QLatin1String("icon")] = data;
+	m_instance->scheduleFlush();
 
-	return getRecord(QLatin1String("icons"), record, canCreate);
+	return visit.identifier;
 }
 
-qint64 HistoryManager::addEntry(const QUrl &url, const QString &title, const QIcon &icon, bool typed)
+bool HistoryManager::hasUrl(const QUrl &url)
 {
-	if (!m_isEnabled || !url.isValid() || !SettingsManager::getValue(QLatin1String("History/RememberBrowsing"), url).toBool())
+	if (!m_isEnabled)
 	{
-		return -1;
+		return false;
 	}
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("INSERT INTO \"visits\" (\"location\", \"icon\", \"title\", \"time\", \"typed\") VALUES(?, ?, ?, ?, ?);"));
-	query.bindValue(0, getLocation(url));
-	query.bindValue(1, getIcon(icon));
-	query.bindValue(2, title);
-	query.bindValue(3, QDateTime::currentDateTime().toTime_t());
-	query.bindValue(4, typed);
-	query.exec();
+	HistoryVisit visit;
+
+	setUrl(url, &visit);
 
-	if (!query.lastInsertId().isNull())
+	for (int i = 0; i < m_pendingVisits.count(); ++i)
 	{
-		const qint64 entry = query.lastInsertId().toLongLong();
+		if (m_pendingVisits.at(i).path == visit.path && m_pendingVisits.at(i).host == visit.host && m_pendingVisits.at(i).scheme == visit.scheme)
+		{
+			return true;
+		}
+	}
 
-		emit m_instance->entryAdded(entry);
+	const qint64 hash = HistoryDatabase::getLocationHash(visit.host, visit.scheme, visit.path);
 
-		return entry;
+// filter is sized from amount of locations and rebuilt after removals or when it gets full, so its rare false positives are accepted instead of confirming them by query
+	if (!m_locationsFilter.isEmpty())
+	{
+		return HistoryDatabase::checkLocationHash(m_locationsFilter, hash);
 	}
 
-	return -1;
-}
-
-bool HistoryManager::hasUrl(const QUrl &url)
-{
-	return (m_isEnabled && getLocation(url, false) >= 0);
+// until filter is loaded only locations added in this session are known, older ones are reported as not visited
+	return m_pendingLocations.contains(hash);
 }
 
 bool HistoryManager::updateEntry(qint64 entry, const QUrl &url, const QString &title, const QIcon &icon)
@@ -412,6 +620,8 @@ bool HistoryManager::updateEntry(qint64 entry, const QUrl &url, const QString &t
 		return false;
 	}
 
+	entry = resolveIdentifier(entry);
+
 	if (!SettingsManager::getValue(QLatin1String("History/RememberBrowsing"), url).toBool())
 	{
 		removeEntry(entry);
@@ -419,48 +629,43 @@ bool HistoryManager::updateEntry(qint64 entry, const QUrl &url, const QString &t
 		return false;
 	}
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("UPDATE \"visits\" SET \"location\" = ?, \"icon\" = ?, \"title\" = ? WHERE \"id\" = ?;"));
-	query.bindValue(0, getLocation(url));
-	query.bindValue(1, getIcon(icon));
-	query.bindValue(2, title);
-	query.bindValue(3, entry);
-	query.exec();
+	HistoryVisit visit;
+	visit.title = title;
+	visit.identifier = entry;
 
-	const bool success = (query.numRowsAffected() > 0);
+	setUrl(url, &visit);
+	setIcon(icon, &visit);
+	addLocation(visit);
 
-	if (success)
+	for (int i = 0; i < m_pendingVisits.count(); ++i)
 	{
-		m_instance->scheduleCleanup();
+		if (m_pendingVisits.at(i).identifier == entry)
+		{
+			visit.time = m_pendingVisits.at(i).time;
+			visit.typed = m_pendingVisits.at(i).typed;
 
-		emit m_instance->entryUpdated(entry);
-	}
+			m_pendingVisits[i] = visit;
 
-	return success;
-}
+			HistoryNotification notification;
+			notification.entry = entry;
+			notification.type = HistoryNotification::UpdatedNotification;
 
-bool HistoryManager::removeEntry(qint64 entry)
-{
-	if (!m_isEnabled)
-	{
-		return false;
+			m_pendingNotifications.append(notification);
+
+			return true;
+		}
 	}
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("DELETE FROM \"visits\" WHERE \"id\" = ?;"));
-	query.bindValue(0, entry);
-	query.exec();
+	flushEntries();
 
-	const bool success = (query.numRowsAffected() > 0);
+	QMetaObject::invokeMethod(m_instance->m_database, "updateVisit", Qt::QueuedConnection, Q_ARG(qint64, entry), Q_ARG(HistoryVisit, visit));
 
-	if (success)
-	{
-		m_instance->scheduleCleanup();
-
-		emit m_instance->entryRemoved(entry);
-	}
+	return true;
+}
 
-	return success;
+bool HistoryManager::removeEntry(qint64 entry)
+{
+	return removeEntries(QList<qint64>() << entry);
 }
 
 bool HistoryManager::removeEntries(const QList<qint64> &entries)
@@ -470,38 +675,56 @@ bool HistoryManager::removeEntries(const QList<qint64> &entries)
 		return false;
 	}
 
-	QStringList list;
+	QList<qint64> identifiers;
 
 	for (int i = 0; i < entries.count(); ++i)
 	{
-		if (entries.at(i) >= 0)
+		const qint64 identifier = resolveIdentifier(entries.at(i));
+
+// visit which still has provisional identifier was never stored, so it is enough to drop it
+		if (identifier < -1)
+		{
+			for (int j = (m_pendingVisits.count() - 1); j >= 0; --j)
+			{
+				if (m_pendingVisits.at(j).identifier == identifier)
+				{
+					m_pendingVisits.removeAt(j);
+				}
+			}
+
+			for (int j = (m_pendingNotifications.count() - 1); j >= 0; --j)
+			{
+				if (m_pendingNotifications.at(j).entry == identifier)
+				{
+					m_pendingNotifications.removeAt(j);
+				}
+			}
+		}
+		else
 		{
-			list.append(QString::number(entries.at(i)));
+			identifiers.append(identifier);
 		}
 	}
 
-	if (list.isEmpty())
-	{
-		return false;
-	}
+	flushEntries();
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QStringLiteral("DELETE FROM \"visits\" WHERE \"id\" IN(%1);").arg(list.join(QLatin1String(", "))));
-	query.exec();
+	QMetaObject::invokeMethod(m_instance->m_database, "removeVisits", Qt::QueuedConnection, Q_ARG(QList<qint64>, identifiers));
 
-	const bool success = (query.numRowsAffected() > 0);
+	return true;
+}
 
-	if (success)
+bool HistoryManager::removeEntries(const QString &host)
+{
+	if (!m_isEnabled)
 	{
-		m_instance->scheduleCleanup();
-
-		for (int i = 0; i < entries.count(); ++i)
-		{
-			emit m_instance->entryRemoved(entries.at(i));
-		}
+		return false;
 	}
 
-	return success;
+	flushEntries();
+
+	QMetaObject::invokeMethod(m_instance->m_database, "removeHostVisits", Qt::QueuedConnection, Q_ARG(QString, host));
+
+	return true;
 }
 
 }
@@ -20,11 +20,12 @@
 #ifndef OTTER_HISTORYMANAGER_H
 #define OTTER_HISTORYMANAGER_H
 
-#include <QtCore/QObject>
-#include <QtCore/QDateTime>
-#include <QtCore/QUrl>
+#include "HistoryDatabase.h"
+
+#include <QtCore/QCache>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
 #include <QtGui/QIcon>
-#include <QtSql/QSqlRecord>
 
 namespace Otter
 {
@@ -51,37 +52,67 @@ public:
 	static void clearHistory(int period = 0);
 	static HistoryManager* getInstance();
 	static HistoryEntry getEntry(qint64 entry);
-	static QList<HistoryEntry> getEntries(bool typed = false);
+	static int searchEntries(const QString &text, int limit = 0, bool isRanked = false);
+	static int requestFrequentEntries(int limit);
+	static int requestEntries(const QDateTime &start = QDateTime(), const QDateTime &end = QDateTime(), const QDateTime &lastTime = QDateTime(), qint64 lastEntry = -1, int limit = 0);
 	static qint64 addEntry(const QUrl &url, const QString &title, const QIcon &icon, bool typed = false);
 	static bool hasUrl(const QUrl &url);
 	static bool updateEntry(qint64 entry, const QUrl &url, const QString &title, const QIcon &icon);
 	static bool removeEntry(qint64 entry);
 	static bool removeEntries(const QList<qint64> &entries);
+	static bool removeEntries(const QString &host);
 
 protected:
 	explicit HistoryManager(QObject *parent = NULL);
+	~HistoryManager();
 
 	void timerEvent(QTimerEvent *event);
 	void scheduleCleanup();
+	void scheduleFlush();
 	void removeOldEntries(const QDateTime &date = QDateTime());
-	static HistoryEntry getEntry(const QSqlRecord &record);
-	static qint64 getRecord(const QLatin1String &table, const QVariantHash &values, bool canCreate = true);
-	static qint64 getLocation(const QUrl &url, bool canCreate = true);
-	static qint64 getIcon(const QIcon &icon, bool canCreate = true);
+	void scheduleLocationsReload();
+	static void flushEntries();
+	static void addLocation(const HistoryVisit &visit);
+	static void setUrl(const QUrl &url, HistoryVisit *visit);
+	static void setIcon(const QIcon &icon, HistoryVisit *visit);
+	static HistoryEntry getEntry(const HistoryRecord &record);
+	static qint64 resolveIdentifier(qint64 entry);
 
 protected slots:
 	void optionChanged(const QString &option);
+	void handleEntryLoaded(qint64 entry, const HistoryRecord &record);
+	void handleLastIdentifierLoaded(qint64 identifier);
+	void handleLocationsLoaded(const QBitArray &filter);
+	void handleNotifications(const QList<HistoryNotification> &notifications);
 
 private:
+	QThread *m_thread;
+	HistoryDatabase *m_database;
 	int m_cleanupTimer;
 	int m_dayTimer;
+	int m_flushTimer;
+	int m_locationsTimer;
 
 	static HistoryManager *m_instance;
+	static QCache<qint64, HistoryEntry> m_entriesCache;
+	static QCache<qint64, QPair<QByteArray, qint64> > m_iconsCache;
+	static QBitArray m_locationsFilter;
+	static QHash<qint64, qint64> m_provisionalIdentifiers;
+	static QSet<qint64> m_requestedEntries;
+	static QVector<qint64> m_pendingLocations;
+	static QList<HistoryVisit> m_pendingVisits;
+	static QList<HistoryNotification> m_pendingNotifications;
+	static qint64 m_lastIdentifier;
+	static qint64 m_lastProvisionalIdentifier;
+	static int m_addedLocations;
+	static int m_lastRequest;
 	static bool m_isEnabled;
+	static bool m_isLoadingLocations;
 	static bool m_isStoringFavicons;
 
 signals:
 	void cleared();
+	void entriesLoaded(int request, const QList<HistoryRecord> &entries);
 	void entryAdded(qint64 entry);
 	void entryUpdated(qint64 entry);
 	void entryRemoved(qint64 entry);
@@ -0,0 +1,391 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "HistoryModel.h"
+#include "HistoryManager.h"
+#include "Utils.h"
+
+#include <QtGui/QPixmap>
+
+namespace Otter
+{
+
+HistoryModel::HistoryModel(QObject *parent) : QStandardItemModel(parent),
+	m_icons(500),
+	m_searchRequest(-1),
+	m_isLoading(true)
+{
+	QStringList groups;
+	groups << tr("Today") << tr("Yesterday") << tr("Earlier This Week") << tr("Previous Week") << tr("Earlier This Month") << tr("Earlier This Year") << tr("Older");
+
+	for (int i = 0; i < groups.count(); ++i)
+	{
+		appendRow(new QStandardItem(Utils::getIcon(QLatin1String("inode-directory")), groups.at(i)));
+	}
+
+	m_groups.resize(groups.count());
+
+	QStringList labels;
+	labels << tr("Address") << tr("Title") << tr("Date");
+
+	setHorizontalHeaderLabels(labels);
+
+	connect(HistoryManager::getInstance(), SIGNAL(cleared()), this, SLOT(reload()));
+	connect(HistoryManager::getInstance(), SIGNAL(dayChanged()), this, SLOT(reload()));
+	connect(HistoryManager::getInstance(), SIGNAL(entriesLoaded(int,QList<HistoryRecord>)), this, SLOT(addEntries(int,QList<HistoryRecord>)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryAdded(qint64)), this, SLOT(addEntry(qint64)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryUpdated(qint64)), this, SLOT(updateEntry(qint64)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryRemoved(qint64)), this, SLOT(removeEntry(qint64)));
+}
+
+void HistoryModel::reload()
+{
+	const QDate date = QDate::currentDate();
+	QList<QDate> dates;
+	dates << date << date.addDays(-1) << date.addDays(-7) << date.addDays(-14) << date.addDays(-30) << date.addDays(-365);
+
+	m_icons.clear();
+	m_entryItems.clear();
+
+// only first page of each group is loaded upfront, further pages are requested by view when needed
+	for (int i = 0; i < m_groups.count(); ++i)
+	{
+		QStandardItem *groupItem = item(i, 0);
+
+		if (groupItem)
+		{
+			groupItem->removeRows(0, groupItem->rowCount());
+		}
+
+		HistoryGroup group;
+		group.start = ((i < dates.count()) ? QDateTime(dates.at(i)) : QDateTime());
+		group.end = ((i > 0) ? m_groups.at(i - 1).start : QDateTime());
+
+		if (m_filter.isEmpty())
+		{
+			group.request = HistoryManager::requestEntries(group.start, group.end, QDateTime(), -1, 100);
+		}
+
+		m_groups[i] = group;
+	}
+
+// filtered view shows only matches from full text index, which are distributed to groups when they arrive
+	m_searchRequest = (m_filter.isEmpty() ? -1 : HistoryManager::searchEntries(m_filter, 1000));
+
+	if (!m_isLoading)
+	{
+		m_isLoading = true;
+
+		emit loadingChanged(true);
+	}
+}
+
+void HistoryModel::addEntries(int request, const QList<HistoryRecord> &entries)
+{
+	if (request >= 0 && request == m_searchRequest)
+	{
+		for (int i = 0; i < entries.count(); ++i)
+		{
+			QStandardItem *groupItem = item(getGroup(entries.at(i).time), 0);
+
+			if (groupItem)
+			{
+				groupItem->appendRow(createEntry(entries.at(i)));
+			}
+		}
+
+		for (int i = 0; i < m_groups.count(); ++i)
+		{
+			m_groups[i].isLoaded = true;
+		}
+
+		m_searchRequest = -1;
+
+		if (m_isLoading)
+		{
+			m_isLoading = false;
+
+			emit loadingChanged(false);
+		}
+
+		return;
+	}
+
+	int index = -1;
+
+	for (int i = 0; i < m_groups.count(); ++i)
+	{
+		if (m_groups.at(i).request == request)
+		{
+			index = i;
+
+			break;
+		}
+	}
+
+	QStandardItem *groupItem = item(index, 0);
+
+	if (!groupItem)
+	{
+		return;
+	}
+
+	HistoryGroup &group = m_groups[index];
+
+	for (int i = 0; i < entries.count(); ++i)
+	{
+		groupItem->appendRow(createEntry(entries.at(i)));
+	}
+
+	if (!entries.isEmpty())
+	{
+		group.lastTime = entries.last().time;
+		group.lastEntry = entries.last().identifier;
+	}
+
+	group.request = -1;
+	group.canFetchMore = (entries.count() == 100);
+	group.isLoaded = true;
+
+	if (m_isLoading)
+	{
+		for (int i = 0; i < m_groups.count(); ++i)
+		{
+			if (!m_groups.at(i).isLoaded)
+			{
+				return;
+			}
+		}
+
+		m_isLoading = false;
+
+		emit loadingChanged(false);
+	}
+}
+
+void HistoryModel::addEntry(qint64 entry)
+{
+	if (!m_filter.isEmpty() || getEntryItem(entry))
+	{
+		return;
+	}
+
+	const HistoryEntry historyEntry = HistoryManager::getEntry(entry);
+	const int index = getGroup(historyEntry.time);
+	QStandardItem *groupItem = item(index, 0);
+
+	if (historyEntry.identifier < 0 || !groupItem)
+	{
+		return;
+	}
+
+// entries not loaded yet will be included in results of pending or future requests
+	const HistoryGroup &group = m_groups.at(index);
+
+	if (!group.isLoaded || (group.canFetchMore && (historyEntry.time < group.lastTime || (historyEntry.time == group.lastTime && entry < group.lastEntry))))
+	{
+		return;
+	}
+
+	int row = 0;
+
+	while (row < groupItem->rowCount())
+	{
+		const QDateTime time = groupItem->child(row, 0)->data(TimeRole).toDateTime();
+
+		if (time < historyEntry.time || (time == historyEntry.time && groupItem->child(row, 0)->data(IdentifierRole).toLongLong() < entry))
+		{
+			break;
+		}
+
+		++row;
+	}
+
+	HistoryRecord record;
+	record.url = historyEntry.url;
+	record.title = historyEntry.title;
+	record.time = historyEntry.time;
+	record.identifier = entry;
+
+	QList<QStandardItem*> entryItems = createEntry(record);
+
+	if (!historyEntry.icon.isNull())
+	{
+		entryItems[0]->setIcon(historyEntry.icon);
+	}
+
+	groupItem->insertRow(row, entryItems);
+}
+
+void HistoryModel::updateEntry(qint64 entry)
+{
+	QStandardItem *entryItem = getEntryItem(entry);
+
+	if (entryItem)
+	{
+		const HistoryEntry historyEntry = HistoryManager::getEntry(entry);
+
+// entry which is not known yet is loaded in background and announced again
+		if (historyEntry.identifier >= 0)
+		{
+			setEntry(entryItem, historyEntry);
+		}
+	}
+	else
+	{
+		addEntry(entry);
+	}
+}
+
+void HistoryModel::removeEntry(qint64 entry)
+{
+	QStandardItem *entryItem = getEntryItem(entry);
+
+	m_entryItems.remove(entry);
+
+	if (entryItem && entryItem->parent())
+	{
+		removeRow(entryItem->row(), entryItem->parent()->index());
+	}
+}
+
+void HistoryModel::setFilter(const QString &filter)
+{
+	if (filter != m_filter)
+	{
+		m_filter = filter;
+
+		reload();
+	}
+}
+
+void HistoryModel::setEntry(QStandardItem *entryItem, const HistoryEntry &entry)
+{
+	QStandardItem *groupItem = entryItem->parent();
+
+	if (!groupItem || entry.identifier < 0)
+	{
+		return;
+	}
+
+	entryItem->setText(entry.url.toString().replace(QLatin1String("%23"), QString(QLatin1Char('#'))));
+	entryItem->setData(entry.identifier, IdentifierRole);
+	entryItem->setData(QByteArray(), IconDataRole);
+	entryItem->setData(entry.time, TimeRole);
+	entryItem->setData((entry.icon.isNull() ? QVariant() : QVariant(entry.icon)), Qt::DecorationRole);
+
+	groupItem->child(entryItem->row(), 1)->setText(entry.title.isEmpty() ? tr("(Untitled)") : entry.title);
+	groupItem->child(entryItem->row(), 2)->setText(entry.time.toString());
+}
+
+void HistoryModel::fetchMore(const QModelIndex &parent)
+{
+	if (!canFetchMore(parent))
+	{
+		return;
+	}
+
+	HistoryGroup &group = m_groups[parent.row()];
+	group.request = HistoryManager::requestEntries(group.start, group.end, group.lastTime, group.lastEntry, 100);
+}
+
+QList<QStandardItem*> HistoryModel::createEntry(const HistoryRecord &entry)
+{
+	QList<QStandardItem*> entryItems;
+	entryItems.append(new QStandardItem(entry.url.toString().replace(QLatin1String("%23"), QString(QLatin1Char('#')))));
+	entryItems.append(new QStandardItem(entry.title.isEmpty() ? tr("(Untitled)") : entry.title));
+	entryItems.append(new QStandardItem(entry.time.toString()));
+	entryItems[0]->setData(entry.identifier, IdentifierRole);
+	entryItems[0]->setData(entry.icon, IconDataRole);
+	entryItems[0]->setData(entry.time, TimeRole);
+
+	m_entryItems[entry.identifier] = entryItems[0];
+
+	return entryItems;
+}
+
+QStandardItem* HistoryModel::getEntryItem(qint64 entry) const
+{
+	return m_entryItems.value(entry, NULL);
+}
+
+QVariant HistoryModel::data(const QModelIndex &index, int role) const
+{
+	if (role != Qt::DecorationRole || index.column() != 0 || !index.parent().isValid())
+	{
+		return QStandardItemModel::data(index, role);
+	}
+
+	const QVariant icon = QStandardItemModel::data(index, role);
+
+	if (!icon.isNull())
+	{
+		return icon;
+	}
+
+// icons are decoded only when shown, identical icons share the same decoded instance
+	const QByteArray data = QStandardItemModel::data(index, IconDataRole).toByteArray();
+
+	if (data.isEmpty())
+	{
+		return Utils::getIcon(QLatin1String("text-html"));
+	}
+
+	if (!m_icons.contains(data))
+	{
+		QPixmap pixmap;
+		pixmap.loadFromData(data);
+
+		m_icons.insert(data, new QIcon(pixmap));
+	}
+
+	return *m_icons.object(data);
+}
+
+int HistoryModel::getGroup(const QDateTime &time) const
+{
+	for (int i = 0; i < m_groups.count(); ++i)
+	{
+		if (!m_groups.at(i).start.isValid() || time >= m_groups.at(i).start)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+bool HistoryModel::canFetchMore(const QModelIndex &parent) const
+{
+	if (!parent.isValid() || parent.parent().isValid() || parent.row() >= m_groups.count())
+	{
+		return false;
+	}
+
+	const HistoryGroup &group = m_groups.at(parent.row());
+
+	return (group.isLoaded && group.canFetchMore && group.request < 0);
+}
+
+bool HistoryModel::isLoading() const
+{
+	return m_isLoading;
+}
+
+}
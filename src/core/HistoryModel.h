@@ -0,0 +1,97 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_HISTORYMODEL_H
+#define OTTER_HISTORYMODEL_H
+
+#include "HistoryDatabase.h"
+
+#include <QtCore/QCache>
+#include <QtCore/QHash>
+#include <QtGui/QIcon>
+#include <QtGui/QStandardItemModel>
+
+namespace Otter
+{
+
+struct HistoryEntry;
+
+class HistoryModel : public QStandardItemModel
+{
+	Q_OBJECT
+
+public:
+	enum HistoryRole
+	{
+		IdentifierRole = Qt::UserRole,
+		IconDataRole = (Qt::UserRole + 1),
+		TimeRole = (Qt::UserRole + 2)
+	};
+
+	explicit HistoryModel(QObject *parent = NULL);
+
+	void fetchMore(const QModelIndex &parent);
+	void setFilter(const QString &filter);
+	QStandardItem* getEntryItem(qint64 entry) const;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	bool canFetchMore(const QModelIndex &parent) const;
+	bool isLoading() const;
+
+public slots:
+	void reload();
+
+protected:
+	struct HistoryGroup
+	{
+		QDateTime start;
+		QDateTime end;
+		QDateTime lastTime;
+		qint64 lastEntry;
+		int request;
+		bool canFetchMore;
+		bool isLoaded;
+
+		HistoryGroup() : lastEntry(-1), request(-1), canFetchMore(false), isLoaded(false) {}
+	};
+
+	void setEntry(QStandardItem *entryItem, const HistoryEntry &entry);
+	QList<QStandardItem*> createEntry(const HistoryRecord &entry);
+	int getGroup(const QDateTime &time) const;
+
+protected slots:
+	void addEntries(int request, const QList<HistoryRecord> &entries);
+	void addEntry(qint64 entry);
+	void updateEntry(qint64 entry);
+	void removeEntry(qint64 entry);
+
+private:
+	QVector<HistoryGroup> m_groups;
+	QHash<qint64, QStandardItem*> m_entryItems;
+	QString m_filter;
+	mutable QCache<QByteArray, QIcon> m_icons;
+	int m_searchRequest;
+	bool m_isLoading;
+
+signals:
+	void loadingChanged(bool isLoading);
+};
+
+}
+
+#endif
@@ -18,17 +18,45 @@
 **************************************************************************/
 
 #include "NetworkCache.h"
+#include "NetworkCacheCleaner.h"
 #include "SessionsManager.h"
 #include "SettingsManager.h"
 
-#include <QtCore/QDateTime>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
 #include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMultiMap>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTimerEvent>
 
 namespace Otter
 {
 
-NetworkCache::NetworkCache(QObject *parent) : QNetworkDiskCache(parent)
+NetworkCache::NetworkCache(QObject *parent) : QNetworkDiskCache(parent),
+	m_thread(new QThread(this)),
+	m_cleaner(new NetworkCacheCleaner()),
+	m_size(0),
+	m_generation(0),
+	m_removedAmount(0),
+	m_totalAmount(0),
+	m_checkpointTimer(0),
+	m_isIndexModified(false),
+	m_isIndexValid(false)
 {
+	qRegisterMetaType<QList<QUrl> >("QList<QUrl>");
+	qRegisterMetaType<QList<NetworkCacheEntry> >("QList<NetworkCacheEntry>");
+
+// files are deleted by worker thread, so clearing large cache does not block user interface
+	m_cleaner->moveToThread(m_thread);
+
+	connect(m_thread, SIGNAL(finished()), m_cleaner, SLOT(deleteLater()));
+	connect(m_cleaner, SIGNAL(filesRemoved(QList<QUrl>)), this, SLOT(handleFilesRemoved(QList<QUrl>)));
+	connect(m_cleaner, SIGNAL(removalCancelled(QList<QUrl>)), this, SLOT(handleRemovalCancelled(QList<QUrl>)));
+	connect(m_cleaner, SIGNAL(filesScanned(QList<NetworkCacheEntry>)), this, SLOT(handleFilesScanned(QList<NetworkCacheEntry>)));
+
+	m_thread->start();
+
 	const QString cachePath = SessionsManager::getCachePath();
 
 	if (!cachePath.isEmpty())
@@ -36,145 +64,631 @@ NetworkCache::NetworkCache(QObject *parent) : QNetworkDiskCache(parent)
 		QDir().mkpath(cachePath);
 
 		setCacheDirectory(cachePath);
+
+// QNetworkDiskCache of Qt 5 stores files in "data8" directory (CACHE_VERSION of qnetworkdiskcache.cpp), newest one is used if other version created its own
+		const QStringList directories = QDir(cachePath).entryList(QStringList(QLatin1String("data*")), (QDir::AllDirs | QDir::NoDotAndDotDot));
+		int version = 8;
+
+		for (int i = 0; i < directories.count(); ++i)
+		{
+			version = qMax(version, directories.at(i).mid(4).toInt());
+		}
+
+		m_dataDirectory = QStringLiteral("data%1/").arg(version);
+
+		loadIndex();
 		setMaximumCacheSize(SettingsManager::getValue(QLatin1String("Cache/DiskCacheLimit")).toInt() * 1024);
+
+		m_checkpointTimer = startTimer(300000);
 	}
 
 	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString,QVariant)));
 }
 
-void NetworkCache::clearCache(int period)
+NetworkCache::~NetworkCache()
 {
-	if (period <= 0)
+// removals still waiting are dropped, files that were not deleted yet are kept in index below
+	cancelClearing();
+
+	m_thread->requestInterruption();
+	m_thread->quit();
+	m_thread->wait();
+
+	const QDir cacheMainDirectory(cacheDirectory());
+	QHash<QUrl, NetworkCacheEntry>::const_iterator iterator;
+
+	for (iterator = m_pendingEntries.constBegin(); iterator != m_pendingEntries.constEnd(); ++iterator)
 	{
-		clear();
+		if (QFile::exists(cacheMainDirectory.absoluteFilePath(iterator.value().path)))
+		{
+			addEntry(iterator.value());
+		}
+	}
 
-		emit cleared();
+	saveIndex();
 
-		return;
+	if (m_isIndexValid && !m_isIndexModified)
+	{
+		QFile::remove(cacheMainDirectory.absoluteFilePath(QLatin1String("index.lock")));
 	}
+}
+
+void NetworkCache::timerEvent(QTimerEvent *event)
+{
+// index is saved periodically too, so after crash only files stored since last checkpoint are missing from it
+	if (event->timerId() == m_checkpointTimer && m_isIndexModified)
+	{
+		saveIndex();
+	}
+}
+
+void NetworkCache::loadIndex()
+{
+	m_entries.clear();
+	m_hostEntries.clear();
+	m_size = 0;
+	m_isIndexValid = false;
 
 	const QDir cacheMainDirectory(cacheDirectory());
-	const QStringList directories = cacheMainDirectory.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+	QFile file(cacheMainDirectory.absoluteFilePath(QLatin1String("index")));
 
-	for (int i = 0; i < directories.count(); ++i)
+	if (file.open(QIODevice::ReadOnly))
 	{
-		const QDir cacheSubDirectory(cacheMainDirectory.absoluteFilePath(directories.at(i)));
-		const QStringList subDirectories = cacheSubDirectory.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+		QDataStream stream(&file);
+		stream.setVersion(QDataStream::Qt_5_0);
 
-		for (int j = 0; j < subDirectories.count(); ++j)
-		{
-			const QDir cacheFilesDirectory(cacheSubDirectory.absoluteFilePath(subDirectories.at(j)));
-			const QStringList files = cacheFilesDirectory.entryList(QDir::Files);
+		quint32 magic = 0;
+		quint16 version = 0;
+		qint32 amount = 0;
+
+		stream >> magic >> version >> amount;
 
-			for (int k = 0; k < files.count(); ++k)
+		if (magic == 0x4F434958 && version == 1)
+		{
+			for (qint32 i = 0; i < amount && stream.status() == QDataStream::Ok; ++i)
 			{
-				const QNetworkCacheMetaData metaData = fileMetaData(cacheFilesDirectory.absoluteFilePath(files.at(k)));
+				NetworkCacheEntry entry;
+
+				stream >> entry.url >> entry.path >> entry.type >> entry.lastModified >> entry.expirationDate >> entry.storedTime >> entry.size;
 
-				if (metaData.isValid() && metaData.lastModified().isValid() && metaData.lastModified().secsTo(QDateTime::currentDateTime()) > (period * 3600))
-				{
-					remove(metaData.url());
-				}
+				addEntry(entry);
 			}
+
+			m_isIndexValid = (stream.status() == QDataStream::Ok);
+		}
+
+		file.close();
+	}
+
+	if (!m_isIndexValid)
+	{
+		m_entries.clear();
+		m_hostEntries.clear();
+		m_size = 0;
+	}
+
+// lock file exists while cache is in use and is removed after clean exit, if it is still there index can miss files stored since last checkpoint
+	QFile lockFile(cacheMainDirectory.absoluteFilePath(QLatin1String("index.lock")));
+
+	if (lockFile.exists())
+	{
+		m_isIndexValid = false;
+	}
+	else
+	{
+		lockFile.open(QIODevice::WriteOnly);
+		lockFile.close();
+	}
+
+	m_isIndexModified = false;
+	m_scanAddedUrls.clear();
+	m_scanRemovedUrls.clear();
+
+// loaded entries are used until worker finishes reading of files, then both are merged
+	if (!m_isIndexValid)
+	{
+		QMetaObject::invokeMethod(m_cleaner, "scanFiles", Qt::QueuedConnection, Q_ARG(QString, cacheDirectory()), Q_ARG(QString, m_dataDirectory));
+	}
+}
+
+void NetworkCache::saveIndex()
+{
+	if (cacheDirectory().isEmpty() || !m_isIndexValid)
+	{
+		return;
+	}
+
+	QSaveFile file(QDir(cacheDirectory()).absoluteFilePath(QLatin1String("index")));
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream << quint32(0x4F434958) << quint16(1) << qint32(m_entries.count());
+
+	QHash<QUrl, NetworkCacheEntry>::const_iterator iterator;
+
+	for (iterator = m_entries.constBegin(); iterator != m_entries.constEnd(); ++iterator)
+	{
+		const NetworkCacheEntry &entry = iterator.value();
+
+		stream << entry.url << entry.path << entry.type << entry.lastModified << entry.expirationDate << entry.storedTime << entry.size;
+	}
+
+	if (file.commit())
+	{
+		m_isIndexModified = false;
+	}
+}
+
+void NetworkCache::addEntry(const NetworkCacheEntry &entry)
+{
+	removeEntry(entry.url);
+
+	m_entries[entry.url] = entry;
+	m_hostEntries.insert(entry.url.host(), entry.url);
+	m_size += entry.size;
+	m_isIndexModified = true;
+
+	if (!m_isIndexValid)
+	{
+		m_scanAddedUrls.insert(entry.url);
+	}
+}
+
+void NetworkCache::removeEntry(const QUrl &url)
+{
+	const QHash<QUrl, NetworkCacheEntry>::iterator iterator = m_entries.find(url);
+
+	if (iterator != m_entries.end())
+	{
+		m_size -= iterator.value().size;
+		m_isIndexModified = true;
+
+		m_hostEntries.remove(url.host(), url);
+		m_entries.erase(iterator);
+	}
+
+	if (!m_isIndexValid)
+	{
+		m_scanRemovedUrls.insert(url);
+	}
+}
+
+void NetworkCache::removeEntries(const QList<QUrl> &urls)
+{
+	if (urls.isEmpty())
+	{
+		return;
+	}
+
+// entries are removed from index at once and hidden from readers until worker deletes their files
+	const QDir cacheMainDirectory(cacheDirectory());
+	QStringList paths;
+	QList<QUrl> removedUrls;
+
+	for (int i = 0; i < urls.count(); ++i)
+	{
+		if (!m_entries.contains(urls.at(i)))
+		{
+			continue;
+		}
+
+		const NetworkCacheEntry entry = m_entries.value(urls.at(i));
+
+		removeEntry(urls.at(i));
+
+		m_pendingEntries[urls.at(i)] = entry;
+
+		paths.append(cacheMainDirectory.absoluteFilePath(entry.path));
+		removedUrls.append(urls.at(i));
+	}
+
+	if (removedUrls.isEmpty())
+	{
+		return;
+	}
+
+	m_totalAmount += removedUrls.count();
+
+	QMetaObject::invokeMethod(m_cleaner, "removeFiles", Qt::QueuedConnection, Q_ARG(int, m_generation), Q_ARG(QStringList, paths), Q_ARG(QList<QUrl>, removedUrls));
+
+	emit clearingProgressChanged(m_removedAmount, m_totalAmount);
+}
+
+void NetworkCache::removeStoredEntries(const QDateTime &threshold)
+{
+	QList<QUrl> entries;
+	QHash<QUrl, NetworkCacheEntry>::const_iterator iterator;
+
+	for (iterator = m_entries.constBegin(); iterator != m_entries.constEnd(); ++iterator)
+	{
+		if (iterator.value().storedTime >= threshold)
+		{
+			entries.append(iterator.key());
+		}
+	}
+
+	removeEntries(entries);
+
+	for (int i = 0; i < entries.count(); ++i)
+	{
+		emit entryRemoved(entries.at(i));
+	}
+}
+
+void NetworkCache::handleFilesRemoved(const QList<QUrl> &urls)
+{
+	for (int i = 0; i < urls.count(); ++i)
+	{
+		m_pendingEntries.remove(urls.at(i));
+	}
+
+	m_removedAmount += urls.count();
+
+	emit clearingProgressChanged(m_removedAmount, m_totalAmount);
+
+	if (m_pendingEntries.isEmpty())
+	{
+		m_removedAmount = 0;
+		m_totalAmount = 0;
+
+		emit clearingFinished();
+	}
+}
+
+void NetworkCache::handleRemovalCancelled(const QList<QUrl> &urls)
+{
+	const QDir cacheMainDirectory(cacheDirectory());
+
+	for (int i = 0; i < urls.count(); ++i)
+	{
+		if (!m_pendingEntries.contains(urls.at(i)))
+		{
+			continue;
+		}
+
+		const NetworkCacheEntry entry = m_pendingEntries.take(urls.at(i));
+
+		if (!m_entries.contains(urls.at(i)) && QFile::exists(cacheMainDirectory.absoluteFilePath(entry.path)))
+		{
+			addEntry(entry);
+
+			emit entryAdded(urls.at(i));
+		}
+	}
+
+	m_totalAmount -= urls.count();
+
+	emit clearingProgressChanged(m_removedAmount, m_totalAmount);
+
+	if (m_pendingEntries.isEmpty())
+	{
+		m_removedAmount = 0;
+		m_totalAmount = 0;
+
+		emit clearingFinished();
+	}
+}
+
+void NetworkCache::handleFilesScanned(const QList<NetworkCacheEntry> &entries)
+{
+	if (m_isIndexValid)
+	{
+		return;
+	}
+
+// entries stored or removed while worker was reading files are already up to date
+	const QSet<QUrl> addedUrls = m_scanAddedUrls;
+	const QSet<QUrl> removedUrls = m_scanRemovedUrls;
+	QSet<QUrl> scannedUrls;
+	QList<QUrl> newUrls;
+
+	m_isIndexValid = true;
+	m_scanAddedUrls.clear();
+	m_scanRemovedUrls.clear();
+
+	for (int i = 0; i < entries.count(); ++i)
+	{
+		const QUrl url = entries.at(i).url;
+
+		scannedUrls.insert(url);
+
+		if (addedUrls.contains(url) || removedUrls.contains(url) || m_pendingEntries.contains(url))
+		{
+			continue;
 		}
+
+		if (!m_entries.contains(url))
+		{
+			newUrls.append(url);
+		}
+
+		addEntry(entries.at(i));
+	}
+
+	QList<QUrl> staleUrls;
+	QHash<QUrl, NetworkCacheEntry>::const_iterator iterator;
+
+	for (iterator = m_entries.constBegin(); iterator != m_entries.constEnd(); ++iterator)
+	{
+		if (!scannedUrls.contains(iterator.key()) && !addedUrls.contains(iterator.key()))
+		{
+			staleUrls.append(iterator.key());
+		}
+	}
+
+	for (int i = 0; i < staleUrls.count(); ++i)
+	{
+		removeEntry(staleUrls.at(i));
+	}
+
+	saveIndex();
+
+	for (int i = 0; i < newUrls.count(); ++i)
+	{
+		emit entryAdded(newUrls.at(i));
+	}
+
+	for (int i = 0; i < staleUrls.count(); ++i)
+	{
+		emit entryRemoved(staleUrls.at(i));
+	}
+
+	if (m_pendingClearThreshold.isValid())
+	{
+		removeStoredEntries(m_pendingClearThreshold);
+
+		m_pendingClearThreshold = QDateTime();
+	}
+
+	if (m_size > maximumCacheSize())
+	{
+		expire();
+	}
+}
+
+void NetworkCache::cancelClearing()
+{
+	m_cleaner->cancel(m_generation);
+
+	++m_generation;
+}
+
+void NetworkCache::clear()
+{
+	QNetworkDiskCache::clear();
+
+// files not known yet are removed once worker finishes reading them
+	if (!m_isIndexValid)
+	{
+		removeEntries(m_entries.keys());
+
+		m_pendingClearThreshold = QDateTime::fromTime_t(0);
 	}
 }
 
+void NetworkCache::clearCache(int period)
+{
+	if (period <= 0)
+	{
+		clear();
+
+		emit cleared();
+
+		return;
+	}
+
+// removes entries stored during given amount of last hours, same as clearing of browsing history
+	const QDateTime threshold = QDateTime::currentDateTime().addSecs(-(period * 3600));
+
+// files not known yet are checked again once worker finishes reading them
+	if (!m_isIndexValid && (!m_pendingClearThreshold.isValid() || threshold < m_pendingClearThreshold))
+	{
+		m_pendingClearThreshold = threshold;
+	}
+
+	removeStoredEntries(threshold);
+}
+
 void NetworkCache::insert(QIODevice *device)
 {
 	QNetworkDiskCache::insert(device);
 
 	if (m_devices.contains(device))
 	{
-		emit entryAdded(m_devices[device]);
+		const QNetworkCacheMetaData metaData = m_devices.take(device);
 
-		m_devices.remove(device);
+		if (!cacheDirectory().isEmpty())
+		{
+			NetworkCacheEntry entry = createEntry(metaData);
+			entry.path = getEntryPath(entry.url);
+
+			const QFileInfo information(QDir(cacheDirectory()).absoluteFilePath(entry.path));
+
+// file is not written if it is larger than whole cache
+			if (information.exists())
+			{
+				entry.storedTime = QDateTime::currentDateTime();
+				entry.size = information.size();
+
+				addEntry(entry);
+			}
+		}
+
+		emit entryAdded(metaData.url());
 	}
 }
 
+QIODevice* NetworkCache::data(const QUrl &url)
+{
+	if (m_pendingEntries.contains(url))
+	{
+		return NULL;
+	}
+
+	return QNetworkDiskCache::data(url);
+}
+
 QIODevice* NetworkCache::prepare(const QNetworkCacheMetaData &metaData)
 {
+// file of entry waiting for removal has the same name, so it can not be stored again until removal is done
+	if (m_pendingEntries.contains(metaData.url()))
+	{
+		return NULL;
+	}
+
 	QIODevice *device = QNetworkDiskCache::prepare(metaData);
 
 	if (device)
 	{
-		m_devices[device] = metaData.url();
+		m_devices[device] = metaData;
 	}
 
 	return device;
 }
 
+QNetworkCacheMetaData NetworkCache::metaData(const QUrl &url)
+{
+	if (m_pendingEntries.contains(url))
+	{
+		return QNetworkCacheMetaData();
+	}
+
+	return QNetworkDiskCache::metaData(url);
+}
+
+NetworkCacheEntry NetworkCache::getEntry(const QUrl &url)
+{
+	return m_entries.value(url);
+}
+
+QString NetworkCache::getEntryPath(const QUrl &url) const
+{
+// follows private naming scheme of QNetworkDiskCache of Qt 5 (QNetworkDiskCachePrivate::uniqueFileName()), so file does not need to be looked up
+	QUrl cleanUrl(url);
+	cleanUrl.setPassword(QString());
+	cleanUrl.setFragment(QString());
+
+	const QByteArray hash = QCryptographicHash::hash(cleanUrl.toEncoded(), QCryptographicHash::Sha1);
+	qlonglong number = 0;
+
+	memcpy(&number, hash.constData(), sizeof(qlonglong));
+
+	const QByteArray identifier = QByteArray::number(number, 36).left(8);
+
+	return m_dataDirectory + QString::number((static_cast<uint>(identifier.at(identifier.length() - 1)) % 16), 16) + QLatin1Char('/') + QLatin1String(identifier) + QLatin1String(".d");
+}
+
 QString NetworkCache::getPathForUrl(const QUrl &url)
 {
-	if (!url.isValid() || !metaData(url).isValid())
+	if (!url.isValid() || cacheDirectory().isEmpty())
 	{
 		return QString();
 	}
 
-	const QDir cacheMainDirectory(cacheDirectory());
-	const QStringList directories = cacheMainDirectory.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+	const NetworkCacheEntry entry = getEntry(url);
 
-	for (int i = 0; i < directories.count(); ++i)
+	if (entry.path.isEmpty())
 	{
-		const QDir cacheSubDirectory(cacheMainDirectory.absoluteFilePath(directories.at(i)));
-		const QStringList subDirectories = cacheSubDirectory.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+		return QString();
+	}
 
-		for (int j = 0; j < subDirectories.count(); ++j)
-		{
-			const QDir cacheFilesDirectory(cacheSubDirectory.absoluteFilePath(subDirectories.at(j)));
-			const QStringList files = cacheFilesDirectory.entryList(QDir::Files);
+	const QString path = QDir(cacheDirectory()).absoluteFilePath(entry.path);
 
-			for (int k = 0; k < files.count(); ++k)
-			{
-				const QString cacheFilePath = cacheFilesDirectory.absoluteFilePath(files.at(k));
-				const QNetworkCacheMetaData metaData = fileMetaData(cacheFilePath);
+	return (QFile::exists(path) ? path : QString());
+}
 
-				if (metaData.isValid() && url == metaData.url())
-				{
-					return cacheFilePath;
-				}
-			}
+QList<QUrl> NetworkCache::getEntries(const QString &host)
+{
+	if (cacheDirectory().isEmpty())
+	{
+		return QList<QUrl>();
+	}
+
+	if (host.isEmpty())
+	{
+		return m_entries.keys();
+	}
+
+	return m_hostEntries.values(host);
+}
+
+NetworkCacheEntry NetworkCache::createEntry(const QNetworkCacheMetaData &metaData)
+{
+	NetworkCacheEntry entry;
+	entry.url = metaData.url();
+	entry.lastModified = metaData.lastModified();
+	entry.expirationDate = metaData.expirationDate();
+
+	const QList<QPair<QByteArray, QByteArray> > headers = metaData.rawHeaders();
+
+	for (int i = 0; i < headers.count(); ++i)
+	{
+		if (headers.at(i).first.toLower() == QByteArray("content-type"))
+		{
+			entry.type = QString(headers.at(i).second);
+
+			break;
 		}
 	}
 
-	return QString();
+	return entry;
 }
 
-QList<QUrl> NetworkCache::getEntries() const
+qint64 NetworkCache::expire()
 {
-	QList<QUrl> entries;
+	if (cacheDirectory().isEmpty())
+	{
+		return 0;
+	}
 
-	const QDir cacheMainDirectory(cacheDirectory());
-	const QStringList directories = cacheMainDirectory.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+// until worker finishes reading files size is not known, cache is expired when they are merged
+	if (!m_isIndexValid || m_size < maximumCacheSize())
+	{
+		return m_size;
+	}
 
-	for (int i = 0; i < directories.count(); ++i)
+// same policy as QNetworkDiskCache, oldest entries are removed until cache is reduced to 90% of its limit, but without reading every file
+	const qint64 limit = ((maximumCacheSize() * 9) / 10);
+	QMultiMap<QDateTime, QUrl> entries;
+	QHash<QUrl, NetworkCacheEntry>::const_iterator entriesIterator;
+
+	for (entriesIterator = m_entries.constBegin(); entriesIterator != m_entries.constEnd(); ++entriesIterator)
 	{
-		const QDir cacheSubDirectory(cacheMainDirectory.absoluteFilePath(directories.at(i)));
-		const QStringList subDirectories = cacheSubDirectory.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+		entries.insert(entriesIterator.value().storedTime, entriesIterator.key());
+	}
 
-		for (int j = 0; j < subDirectories.count(); ++j)
-		{
-			const QDir cacheFilesDirectory(cacheSubDirectory.absoluteFilePath(subDirectories.at(j)));
-			const QStringList files = cacheFilesDirectory.entryList(QDir::Files);
+	QMultiMap<QDateTime, QUrl>::const_iterator iterator;
+	QList<QUrl> urls;
+	qint64 size = m_size;
 
-			for (int k = 0; k < files.count(); ++k)
-			{
-				const QNetworkCacheMetaData metaData = fileMetaData(cacheFilesDirectory.absoluteFilePath(files.at(k)));
+	for (iterator = entries.constBegin(); iterator != entries.constEnd() && size > limit; ++iterator)
+	{
+		urls.append(iterator.value());
 
-				if (metaData.url().isValid())
-				{
-					entries.append(metaData.url());
-				}
-			}
-		}
+		size -= m_entries.value(iterator.value()).size;
 	}
 
-	return entries;
+	removeEntries(urls);
+
+	return m_size;
 }
 
 bool NetworkCache::remove(const QUrl &url)
 {
+	if (m_pendingEntries.contains(url))
+	{
+		return false;
+	}
+
 	const bool result = QNetworkDiskCache::remove(url);
 
+	removeEntry(url);
+
 	if (result)
 	{
 		emit entryRemoved(url);
@@ -183,6 +697,11 @@ bool NetworkCache::remove(const QUrl &url)
 	return result;
 }
 
+bool NetworkCache::isClearing() const
+{
+	return !m_pendingEntries.isEmpty();
+}
+
 void NetworkCache::optionChanged(const QString &option, const QVariant &value)
 {
 	if (option == QLatin1String("Cache/DiskCacheLimit"))
@@ -20,37 +20,99 @@
 #ifndef OTTER_NETWORKCACHE_H
 #define OTTER_NETWORKCACHE_H
 
+#include <QtCore/QDateTime>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
 #include <QtNetwork/QNetworkDiskCache>
 
 namespace Otter
 {
 
+struct NetworkCacheEntry
+{
+	QUrl url;
+	QString path;
+	QString type;
+	QDateTime lastModified;
+	QDateTime expirationDate;
+	QDateTime storedTime;
+	qint64 size;
+
+	NetworkCacheEntry() : size(0) {}
+};
+
+class NetworkCacheCleaner;
+
 class NetworkCache : public QNetworkDiskCache
 {
 	Q_OBJECT
 
 public:
 	explicit NetworkCache(QObject *parent = NULL);
+	~NetworkCache();
 
 	void clearCache(int period = 0);
+	void cancelClearing();
 	void insert(QIODevice *device);
+	QIODevice* data(const QUrl &url);
 	QIODevice* prepare(const QNetworkCacheMetaData &metaData);
+	QNetworkCacheMetaData metaData(const QUrl &url);
+	NetworkCacheEntry getEntry(const QUrl &url);
 	QString getPathForUrl(const QUrl &url);
-	QList<QUrl> getEntries() const;
+	QList<QUrl> getEntries(const QString &host = QString());
+	static NetworkCacheEntry createEntry(const QNetworkCacheMetaData &metaData);
 	bool remove(const QUrl &url);
+	bool isClearing() const;
+
+public slots:
+	void clear();
+
+protected:
+	void timerEvent(QTimerEvent *event);
+	void loadIndex();
+	void saveIndex();
+	void addEntry(const NetworkCacheEntry &entry);
+	void removeEntry(const QUrl &url);
+	void removeEntries(const QList<QUrl> &urls);
+	void removeStoredEntries(const QDateTime &threshold);
+	QString getEntryPath(const QUrl &url) const;
+	qint64 expire();
 
 protected slots:
 	void optionChanged(const QString &option, const QVariant &value);
+	void handleFilesRemoved(const QList<QUrl> &urls);
+	void handleRemovalCancelled(const QList<QUrl> &urls);
+	void handleFilesScanned(const QList<NetworkCacheEntry> &entries);
 
 private:
-	QHash<QIODevice*, QUrl> m_devices;
+	QThread *m_thread;
+	NetworkCacheCleaner *m_cleaner;
+	QString m_dataDirectory;
+	QDateTime m_pendingClearThreshold;
+	QHash<QIODevice*, QNetworkCacheMetaData> m_devices;
+	QHash<QUrl, NetworkCacheEntry> m_entries;
+	QHash<QUrl, NetworkCacheEntry> m_pendingEntries;
+	QMultiHash<QString, QUrl> m_hostEntries;
+	QSet<QUrl> m_scanAddedUrls;
+	QSet<QUrl> m_scanRemovedUrls;
+	qint64 m_size;
+	int m_generation;
+	int m_removedAmount;
+	int m_totalAmount;
+	int m_checkpointTimer;
+	bool m_isIndexModified;
+	bool m_isIndexValid;
 
 signals:
 	void cleared();
+	void clearingFinished();
+	void clearingProgressChanged(int removed, int total);
 	void entryAdded(QUrl url);
 	void entryRemoved(QUrl url);
 };
 
 }
 
+Q_DECLARE_METATYPE(Otter::NetworkCacheEntry)
+
 #endif
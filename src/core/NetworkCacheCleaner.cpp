@@ -0,0 +1,103 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2014 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "NetworkCacheCleaner.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QThread>
+
+namespace Otter
+{
+
+NetworkCacheCleaner::NetworkCacheCleaner(QObject *parent) : QObject(parent),
+	m_cancelledGeneration(-1)
+{
+}
+
+void NetworkCacheCleaner::cancel(int generation)
+{
+	m_cancelledGeneration.fetchAndStoreOrdered(generation);
+}
+
+void NetworkCacheCleaner::removeFiles(int generation, const QStringList &paths, const QList<QUrl> &urls)
+{
+// files are removed in small batches, so progress can be reported and cancellation is noticed quickly
+	for (int i = 0; i < paths.count(); i += 100)
+	{
+		if (generation <= m_cancelledGeneration.load() || QThread::currentThread()->isInterruptionRequested())
+		{
+			emit removalCancelled(urls.mid(i));
+
+			return;
+		}
+
+		const int amount = qMin(100, (paths.count() - i));
+
+		for (int j = i; j < (i + amount); ++j)
+		{
+			QFile::remove(paths.at(j));
+		}
+
+		emit filesRemoved(urls.mid(i, amount));
+	}
+}
+
+void NetworkCacheCleaner::scanFiles(const QString &cachePath, const QString &dataPath)
+{
+// separate instance is used for reading, since QNetworkDiskCache keeps state of last read file
+	QNetworkDiskCache reader;
+	const QDir cacheMainDirectory(cachePath);
+	const QDir cacheDataDirectory(cacheMainDirectory.absoluteFilePath(dataPath));
+	const QStringList directories = cacheDataDirectory.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+	QList<NetworkCacheEntry> entries;
+
+	for (int i = 0; i < directories.count(); ++i)
+	{
+		const QDir cacheFilesDirectory(cacheDataDirectory.absoluteFilePath(directories.at(i)));
+		const QStringList files = cacheFilesDirectory.entryList(QStringList(QLatin1String("*.d")), QDir::Files);
+
+		for (int j = 0; j < files.count(); ++j)
+		{
+			if (QThread::currentThread()->isInterruptionRequested())
+			{
+				return;
+			}
+
+			const QString path = cacheFilesDirectory.absoluteFilePath(files.at(j));
+			const QNetworkCacheMetaData metaData = reader.fileMetaData(path);
+
+			if (metaData.isValid() && metaData.url().isValid())
+			{
+				const QFileInfo information(path);
+				NetworkCacheEntry entry = NetworkCache::createEntry(metaData);
+				entry.path = cacheMainDirectory.relativeFilePath(path);
+				entry.storedTime = information.lastModified();
+				entry.size = information.size();
+
+				entries.append(entry);
+			}
+		}
+	}
+
+	emit filesScanned(entries);
+}
+
+}
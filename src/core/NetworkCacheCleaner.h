@@ -0,0 +1,57 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2014 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_NETWORKCACHECLEANER_H
+#define OTTER_NETWORKCACHECLEANER_H
+
+#include "NetworkCache.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QUrl>
+
+namespace Otter
+{
+
+class NetworkCacheCleaner : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit NetworkCacheCleaner(QObject *parent = NULL);
+
+	void cancel(int generation);
+
+public slots:
+	void removeFiles(int generation, const QStringList &paths, const QList<QUrl> &urls);
+	void scanFiles(const QString &cachePath, const QString &dataPath);
+
+private:
+	QAtomicInt m_cancelledGeneration;
+
+signals:
+	void filesRemoved(const QList<QUrl> &urls);
+	void removalCancelled(const QList<QUrl> &urls);
+	void filesScanned(const QList<NetworkCacheEntry> &entries);
+};
+
+}
+
+#endif
@@ -20,8 +20,12 @@
 
 #include "SettingsManager.h"
 
+#include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QSettings>
+#include <QtCore/QStringList>
+#include <QtCore/QTimerEvent>
+#include <QtNetwork/QHostAddress>
 
 namespace Otter
 {
@@ -29,10 +33,28 @@ namespace Otter
 SettingsManager* SettingsManager::m_instance = NULL;
 QString SettingsManager::m_globalPath;
 QString SettingsManager::m_overridePath;
-QHash<QString, QVariant> SettingsManager::m_defaults;
+QHash<QString, int> SettingsManager::m_identifiers;
+QHash<int, QVector<SettingsManager::OptionListener> > SettingsManager::m_listeners;
+QVector<QString> SettingsManager::m_names;
+QVector<int> SettingsManager::m_groups;
+QVector<QVariant> SettingsManager::m_defaults;
+QVector<QVariant> SettingsManager::m_globalValues;
+QHash<QString, QVariant> SettingsManager::m_unregisteredValues;
+QHash<QString, QHash<QString, QVariant> > SettingsManager::m_overrides;
+QHash<QString, QDateTime> SettingsManager::m_savedTimes;
+bool SettingsManager::m_isGlobalModified = false;
+bool SettingsManager::m_isOverrideModified = false;
 
-SettingsManager::SettingsManager(QObject *parent) : QObject(parent)
+SettingsManager::SettingsManager(QObject *parent) : QObject(parent),
+	m_watcher(new QFileSystemWatcher(this)),
+	m_saveTimer(0)
 {
+	connect(m_watcher, SIGNAL(fileChanged(QString)), this, SLOT(fileChanged(QString)));
+}
+
+SettingsManager::~SettingsManager()
+{
+	saveValues();
 }
 
 void SettingsManager::createInstance(const QString &path, QObject *parent)
@@ -42,33 +64,313 @@ void SettingsManager::createInstance(const QString &path, QObject *parent)
 		m_instance = new SettingsManager(parent);
 		m_globalPath = path + QLatin1String("/otter.conf");
 		m_overridePath = path + QLatin1String("/override.ini");
+
+		QHash<QString, QVariant> values;
+
+		loadValues(m_globalPath, &values);
+		setGlobalValues(values);
+		loadOverrides();
+	}
+}
+
+void SettingsManager::addListener(const QString &key, QObject *object, const char *method)
+{
+	if (!object || !method)
+	{
+		return;
+	}
+
+// method is passed using SLOT() macro, same as for connect()
+	const int index = object->metaObject()->indexOfMethod(QMetaObject::normalizedSignature(method + 1).constData());
+
+	if (index < 0)
+	{
+		return;
+	}
+
+	const int identifier = getOptionIdentifier(key);
+
+	if (identifier < 0)
+	{
+		return;
+	}
+
+	OptionListener listener;
+	listener.object = object;
+	listener.method = object->metaObject()->method(index);
+
+	m_listeners[identifier].append(listener);
+}
+
+void SettingsManager::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_saveTimer)
+	{
+		killTimer(m_saveTimer);
+
+		m_saveTimer = 0;
+
+		saveValues();
+	}
+}
+
+void SettingsManager::fileChanged(const QString &path)
+{
+	const QFileInfo information(path);
+
+// files replaced by atomic save are dropped from watcher, so they need to be watched again
+	if (information.exists() && !m_watcher->files().contains(path))
+	{
+		m_watcher->addPath(path);
+	}
+
+	if (information.lastModified() == m_savedTimes.value(path))
+	{
+		return;
+	}
+
+	if (path == m_overridePath)
+	{
+		loadOverrides();
+
+		m_isOverrideModified = false;
+
+		return;
+	}
+
+	if (path != m_globalPath)
+	{
+		return;
+	}
+
+	const QVector<QVariant> oldValues = m_globalValues;
+	QHash<QString, QVariant> values;
+
+	loadValues(m_globalPath, &values);
+
+	m_globalValues.fill(QVariant());
+	m_unregisteredValues.clear();
+	m_isGlobalModified = false;
+
+	setGlobalValues(values);
+
+	for (int i = 0; i < m_globalValues.count(); ++i)
+	{
+		const QVariant oldValue = ((i < oldValues.count() && oldValues.at(i).isValid()) ? oldValues.at(i) : m_defaults.at(i));
+		const QVariant newValue = getValue(i);
+
+		if (!areValuesEqual(i, oldValue, newValue))
+		{
+			notifyListeners(i, newValue);
+		}
+	}
+}
+
+void SettingsManager::setGlobalValues(const QHash<QString, QVariant> &values)
+{
+// values of options without registered default are kept aside until registration, so they are neither lost nor given identifiers
+	QHash<QString, QVariant>::const_iterator iterator;
+
+	for (iterator = values.constBegin(); iterator != values.constEnd(); ++iterator)
+	{
+		const int identifier = getOptionIdentifier(iterator.key());
+
+		if (identifier < 0)
+		{
+			m_unregisteredValues[iterator.key()] = iterator.value();
+		}
+		else
+		{
+			m_globalValues[identifier] = iterator.value();
+		}
+	}
+}
+
+void SettingsManager::scheduleSave()
+{
+	if (m_instance && m_instance->m_saveTimer == 0)
+	{
+		m_instance->m_saveTimer = m_instance->startTimer(1000);
+	}
+}
+
+void SettingsManager::saveValues()
+{
+	if (m_isGlobalModified)
+	{
+		QHash<QString, QVariant> values(m_unregisteredValues);
+
+		for (int i = 0; i < m_globalValues.count(); ++i)
+		{
+			if (m_globalValues.at(i).isValid())
+			{
+				values[m_names.at(i)] = m_globalValues.at(i);
+			}
+		}
+
+		saveValues(m_globalPath, values);
+
+		m_isGlobalModified = false;
+	}
+
+	if (m_isOverrideModified)
+	{
+		QHash<QString, QVariant> values;
+		QHash<QString, QHash<QString, QVariant> >::const_iterator hostsIterator;
+
+		for (hostsIterator = m_overrides.constBegin(); hostsIterator != m_overrides.constEnd(); ++hostsIterator)
+		{
+			QHash<QString, QVariant>::const_iterator optionsIterator;
+
+			for (optionsIterator = hostsIterator.value().constBegin(); optionsIterator != hostsIterator.value().constEnd(); ++optionsIterator)
+			{
+				values[hostsIterator.key() + QLatin1Char('/') + optionsIterator.key()] = optionsIterator.value();
+			}
+		}
+
+		saveValues(m_overridePath, values);
+
+		m_isOverrideModified = false;
+	}
+}
+
+void SettingsManager::loadValues(const QString &path, QHash<QString, QVariant> *values)
+{
+	values->clear();
+
+	QSettings settings(path, QSettings::IniFormat);
+	const QStringList keys = settings.allKeys();
+
+	for (int i = 0; i < keys.count(); ++i)
+	{
+		values->insert(keys.at(i), settings.value(keys.at(i)));
+	}
+
+	m_savedTimes[path] = QFileInfo(path).lastModified();
+
+	if (m_instance && QFile::exists(path) && !m_instance->m_watcher->files().contains(path))
+	{
+		m_instance->m_watcher->addPath(path);
+	}
+}
+
+void SettingsManager::loadOverrides()
+{
+	QHash<QString, QVariant> values;
+
+	loadValues(m_overridePath, &values);
+
+// keys are stored as host followed by option name, they are split once here so lookups need no string building
+	m_overrides.clear();
+
+	QHash<QString, QVariant>::const_iterator iterator;
+
+	for (iterator = values.constBegin(); iterator != values.constEnd(); ++iterator)
+	{
+		const int position = iterator.key().indexOf(QLatin1Char('/'));
+
+		if (position > 0)
+		{
+			m_overrides[iterator.key().left(position).toLower()][iterator.key().mid(position + 1)] = iterator.value();
+		}
+	}
+}
+
+void SettingsManager::saveValues(const QString &path, const QHash<QString, QVariant> &values)
+{
+// whole file is written at once, QSettings writes it through temporary file so it is never left incomplete
+	QSettings settings(path, QSettings::IniFormat);
+	settings.clear();
+
+	QHash<QString, QVariant>::const_iterator iterator;
+
+	for (iterator = values.constBegin(); iterator != values.constEnd(); ++iterator)
+	{
+		settings.setValue(iterator.key(), iterator.value());
+	}
+
+	settings.sync();
+
+	m_savedTimes[path] = QFileInfo(path).lastModified();
+
+	if (m_instance && QFile::exists(path) && !m_instance->m_watcher->files().contains(path))
+	{
+		m_instance->m_watcher->addPath(path);
 	}
 }
 
 void SettingsManager::registerOption(const QString &key)
 {
-	QSettings(m_globalPath, QSettings::IniFormat).remove(key);
+	const int identifier = getOptionIdentifier(key);
+
+	if (identifier < 0)
+	{
+		return;
+	}
 
-	emit m_instance->valueChanged(key, getValue(key));
+	if (m_globalValues.at(identifier).isValid())
+	{
+		m_globalValues[identifier] = QVariant();
+		m_isGlobalModified = true;
+
+		scheduleSave();
+	}
+
+	notifyListeners(identifier, getValue(identifier));
 }
 
 void SettingsManager::removeOverride(const QUrl &url, const QString &key)
 {
+// only overrides of exact host are removed, ones of parent domains are shared with other subdomains
+	const QString host = getHost(url);
+
+	if (!m_overrides.contains(host))
+	{
+		return;
+	}
+
 	if (key.isEmpty())
 	{
-		QSettings(m_overridePath, QSettings::IniFormat).remove(url.isLocalFile() ? QLatin1String("localhost") : url.host());
+		m_overrides.remove(host);
+	}
+	else if (m_overrides[host].remove(key) == 0)
+	{
+		return;
 	}
-	else
+	else if (m_overrides[host].isEmpty())
 	{
-		QSettings(m_overridePath, QSettings::IniFormat).remove((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key);
+		m_overrides.remove(host);
 	}
+
+	m_isOverrideModified = true;
+
+	scheduleSave();
 }
 
 void SettingsManager::setDefaultValue(const QString &key, const QVariant &value)
 {
-	m_defaults[key] = value;
+	int identifier = getOptionIdentifier(key);
+	const bool isRegistered = (identifier >= 0 && m_defaults.at(identifier).isValid());
+
+	if (identifier < 0)
+	{
+		identifier = createOptionIdentifier(key);
+
+		if (m_unregisteredValues.contains(key))
+		{
+			m_globalValues[identifier] = m_unregisteredValues.take(key);
+		}
+	}
 
-	emit m_instance->valueChanged(key, getValue(key));
+	const QVariant oldValue = getValue(identifier);
+
+	m_defaults[identifier] = value;
+
+// initial registration of defaults at startup does not wake anyone, nothing could depend on these options yet
+	if (isRegistered && !areValuesEqual(identifier, oldValue, getValue(identifier)))
+	{
+		notifyListeners(identifier, getValue(identifier));
+	}
 }
 
 void SettingsManager::setValue(const QString &key, const QVariant &value, const QUrl &url)
@@ -77,21 +379,91 @@ void SettingsManager::setValue(const QString &key, const QVariant &value, const
 	{
 		if (value.isNull())
 		{
-			QSettings(m_overridePath, QSettings::IniFormat).remove((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key);
+			removeOverride(url, key);
+
+			return;
 		}
-		else
+
+		m_overrides[getHost(url)][key] = value;
+		m_isOverrideModified = true;
+
+		scheduleSave();
+
+		return;
+	}
+
+	const int identifier = getOptionIdentifier(key);
+
+	if (identifier < 0)
+	{
+		if (m_unregisteredValues.value(key) != value)
 		{
-			QSettings(m_overridePath, QSettings::IniFormat).setValue((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key, value);
+			m_unregisteredValues[key] = value;
+			m_isGlobalModified = true;
+
+			scheduleSave();
+
+			emit m_instance->valueChanged(key, value);
 		}
 
 		return;
 	}
 
-	if (getValue(key) != value)
+	if (!areValuesEqual(identifier, getValue(identifier), value))
 	{
-		QSettings(m_globalPath, QSettings::IniFormat).setValue(key, value);
+		m_globalValues[identifier] = value;
+		m_isGlobalModified = true;
+
+		scheduleSave();
 
-		emit m_instance->valueChanged(key, value);
+		notifyListeners(identifier, value);
+	}
+}
+
+void SettingsManager::notifyListeners(int identifier, const QVariant &value)
+{
+	const QString name = m_names.at(identifier);
+
+	emit m_instance->valueChanged(name, value);
+
+// listeners of every enclosing group are notified too, so "Content/" hears about "Content/Fonts/Default"
+	for (int listenersIdentifier = identifier; listenersIdentifier >= 0; listenersIdentifier = m_groups.at(listenersIdentifier))
+	{
+		if (!m_listeners.contains(listenersIdentifier))
+		{
+			continue;
+		}
+
+// listeners may add or remove other listeners, so copy is used
+		const QVector<OptionListener> listeners = m_listeners[listenersIdentifier];
+		QVector<OptionListener> activeListeners;
+
+		for (int j = 0; j < listeners.count(); ++j)
+		{
+			if (listeners.at(j).object)
+			{
+				listeners.at(j).method.invoke(listeners.at(j).object, Qt::DirectConnection, Q_ARG(QString, name), Q_ARG(QVariant, value));
+			}
+		}
+
+		QVector<OptionListener> &currentListeners = m_listeners[listenersIdentifier];
+
+		for (int j = 0; j < currentListeners.count(); ++j)
+		{
+			if (currentListeners.at(j).object)
+			{
+				activeListeners.append(currentListeners.at(j));
+			}
+		}
+
+		if (activeListeners.isEmpty())
+		{
+			m_listeners.remove(listenersIdentifier);
+		}
+		else
+		{
+			currentListeners = activeListeners;
+		}
 	}
 }
 
@@ -100,31 +472,169 @@ SettingsManager* SettingsManager::getInstance()
 	return m_instance;
 }
 
+QString SettingsManager::getHost(const QUrl &url)
+{
+	return (url.isLocalFile() ? QLatin1String("localhost") : url.host().toLower());
+}
+
+QStringList SettingsManager::getOverrideChain(const QUrl &url)
+{
+// overrides of parent domains apply to their subdomains unless these have own ones, walk stops before public suffix and is not done for addresses
+	QString host = getHost(url);
+	QStringList hosts;
+
+	if (host.isEmpty())
+	{
+		return hosts;
+	}
+
+	hosts.append(host);
+
+	if (url.isLocalFile() || !QHostAddress(host).isNull())
+	{
+		return hosts;
+	}
+
+	const QString suffix = url.topLevelDomain().toLower();
+	int position = host.indexOf(QLatin1Char('.'));
+
+	while (position >= 0)
+	{
+		host = host.mid(position + 1);
+
+// suffix includes leading dot, unknown suffixes are assumed to consist of last label
+		if (suffix.isEmpty() ? !host.contains(QLatin1Char('.')) : (host.length() < suffix.length()))
+		{
+			break;
+		}
+
+		hosts.append(host);
+
+		position = host.indexOf(QLatin1Char('.'));
+	}
+
+	return hosts;
+}
+
+QString SettingsManager::getOptionName(int identifier)
+{
+	return m_names.value(identifier);
+}
+
 QVariant SettingsManager::getDefaultValue(const QString &key)
 {
-	return m_defaults[key];
+	return m_defaults.value(getOptionIdentifier(key));
 }
 
 QVariant SettingsManager::getValue(const QString &key, const QUrl &url)
 {
-	if (!url.isEmpty())
+	const int identifier = getOptionIdentifier(key);
+
+	return ((identifier < 0) ? m_unregisteredValues.value(key) : getValue(identifier, url));
+}
+
+QVariant SettingsManager::getValue(int identifier, const QUrl &url)
+{
+	if (identifier < 0 || identifier >= m_names.count())
+	{
+		return QVariant();
+	}
+
+	if (!url.isEmpty() && !m_overrides.isEmpty())
+	{
+		const QString key = m_names.at(identifier);
+		const QStringList hosts = getOverrideChain(url);
+
+		for (int i = 0; i < hosts.count(); ++i)
+		{
+			const QHash<QString, QHash<QString, QVariant> >::const_iterator hostsIterator = m_overrides.constFind(hosts.at(i));
+
+			if (hostsIterator != m_overrides.constEnd())
+			{
+				const QHash<QString, QVariant>::const_iterator optionsIterator = hostsIterator.value().constFind(key);
+
+				if (optionsIterator != hostsIterator.value().constEnd())
+				{
+					return optionsIterator.value();
+				}
+			}
+		}
+	}
+
+	return (m_globalValues.at(identifier).isValid() ? m_globalValues.at(identifier) : m_defaults.at(identifier));
+}
+
+QHash<QString, QVariant> SettingsManager::getOverrides(const QString &host)
+{
+	return m_overrides.value(host.toLower());
+}
+
+QStringList SettingsManager::getOverrideHosts()
+{
+	return m_overrides.keys();
+}
+
+int SettingsManager::createOptionIdentifier(const QString &key)
+{
+	const QHash<QString, int>::const_iterator iterator = m_identifiers.constFind(key);
+
+	if (iterator != m_identifiers.constEnd())
 	{
-		return QSettings(m_overridePath, QSettings::IniFormat).value((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key, getValue(key));
+		return iterator.value();
 	}
 
-	return QSettings(m_globalPath, QSettings::IniFormat).value(key, getDefaultValue(key));
+// keys ending with slash denote groups of options, like "Content/"
+	const int position = key.lastIndexOf(QLatin1Char('/'), -2);
+	const int group = ((position > 0) ? createOptionIdentifier(key.left(position + 1)) : -1);
+	const int identifier = m_names.count();
+
+	m_identifiers[key] = identifier;
+	m_names.append(key);
+	m_groups.append(group);
+	m_defaults.append(QVariant());
+	m_globalValues.append(QVariant());
+
+	return identifier;
 }
 
-bool SettingsManager::hasOverride(const QUrl &url, const QString &key)
+int SettingsManager::getOptionIdentifier(const QString &key)
 {
-	if (key.isEmpty())
+// identifiers are assigned only by registration of default values, so lookups never modify tables and are safe from any thread
+	return m_identifiers.value(key, -1);
+}
+
+bool SettingsManager::areValuesEqual(int identifier, const QVariant &first, const QVariant &second)
+{
+// values read from file are strings while values set at runtime are typed, so both are converted to type of default value
+	const QVariant &defaultValue = m_defaults.at(identifier);
+
+	if (!defaultValue.isValid() || first.userType() == second.userType())
+	{
+		return (first == second);
+	}
+
+	QVariant normalizedFirst(first);
+	QVariant normalizedSecond(second);
+
+	if (normalizedFirst.convert(defaultValue.userType()) && normalizedSecond.convert(defaultValue.userType()))
 	{
-		return QSettings(m_overridePath, QSettings::IniFormat).childGroups().contains(url.isLocalFile() ? QLatin1String("localhost") : url.host());
+		return (normalizedFirst == normalizedSecond);
 	}
-	else
+
+	return (first == second);
+}
+
+bool SettingsManager::hasOverride(const QUrl &url, const QString &key)
+{
+// reports only overrides of exact host, like removeOverride() removes, inherited ones are applied by getValue()
+	const QHash<QString, QHash<QString, QVariant> >::const_iterator iterator = m_overrides.constFind(getHost(url));
+
+	if (iterator == m_overrides.constEnd())
 	{
-		return QSettings(m_overridePath, QSettings::IniFormat).contains((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key);
+		return false;
 	}
+
+	return (key.isEmpty() || iterator.value().contains(key));
 }
 
 }
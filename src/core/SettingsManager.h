@@ -21,9 +21,15 @@
 #ifndef OTTER_SETTINGSMANAGER_H
 #define OTTER_SETTINGSMANAGER_H
 
+#include <QtCore/QDateTime>
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QMetaMethod>
 #include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QStringList>
 #include <QtCore/QUrl>
 #include <QtCore/QVariant>
+#include <QtCore/QVector>
 
 namespace Otter
 {
@@ -34,6 +40,7 @@ class SettingsManager : public QObject
 
 public:
 	static void createInstance(const QString &path, QObject *parent = NULL);
+	static void addListener(const QString &key, QObject *object, const char *method);
 	static void registerOption(const QString &key);
 	static void removeOverride(const QUrl &url, const QString &key = QString());
 	static void setDefaultValue(const QString &key, const QVariant &value);
@@ -41,16 +48,57 @@ public:
 	static SettingsManager* getInstance();
 	static QVariant getDefaultValue(const QString &key);
 	static QVariant getValue(const QString &key, const QUrl &url = QUrl());
+	static QVariant getValue(int identifier, const QUrl &url = QUrl());
+	static QString getOptionName(int identifier);
+	static QHash<QString, QVariant> getOverrides(const QString &host);
+	static QStringList getOverrideHosts();
+	static int getOptionIdentifier(const QString &key);
 	static bool hasOverride(const QUrl &url, const QString &key = QString());
 
 protected:
 	explicit SettingsManager(QObject *parent = NULL);
+	~SettingsManager();
+
+	void timerEvent(QTimerEvent *event);
+	static void scheduleSave();
+	static void saveValues();
+	static void loadValues(const QString &path, QHash<QString, QVariant> *values);
+	static void loadOverrides();
+	static void saveValues(const QString &path, const QHash<QString, QVariant> &values);
+	static void notifyListeners(int identifier, const QVariant &value);
+	static void setGlobalValues(const QHash<QString, QVariant> &values);
+	static QString getHost(const QUrl &url);
+	static QStringList getOverrideChain(const QUrl &url);
+	static int createOptionIdentifier(const QString &key);
+	static bool areValuesEqual(int identifier, const QVariant &first, const QVariant &second);
+
+protected slots:
+	void fileChanged(const QString &path);
 
 private:
+	struct OptionListener
+	{
+		QPointer<QObject> object;
+		QMetaMethod method;
+	};
+
+	QFileSystemWatcher *m_watcher;
+	int m_saveTimer;
+
 	static SettingsManager *m_instance;
 	static QString m_globalPath;
 	static QString m_overridePath;
-	static QHash<QString, QVariant> m_defaults;
+	static QHash<QString, int> m_identifiers;
+	static QHash<int, QVector<OptionListener> > m_listeners;
+	static QVector<QString> m_names;
+	static QVector<int> m_groups;
+	static QVector<QVariant> m_defaults;
+	static QVector<QVariant> m_globalValues;
+	static QHash<QString, QVariant> m_unregisteredValues;
+	static QHash<QString, QHash<QString, QVariant> > m_overrides;
+	static QHash<QString, QDateTime> m_savedTimes;
+	static bool m_isGlobalModified;
+	static bool m_isOverrideModified;
 
 signals:
 	void valueChanged(QString key, QVariant value);
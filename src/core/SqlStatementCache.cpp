@@ -0,0 +1,191 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "SqlStatementCache.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtSql/QSqlDatabase>
+
+namespace Otter
+{
+
+SqlStatementCache::SqlStatementCache(const QString &connection) : m_connection(connection)
+{
+}
+
+SqlStatementCache::~SqlStatementCache()
+{
+	clear();
+}
+
+void SqlStatementCache::setConnection(const QString &connection)
+{
+	if (connection != m_connection)
+	{
+		clear();
+
+		m_connection = connection;
+	}
+}
+
+void SqlStatementCache::clear()
+{
+// statements have to be released before their connection is closed or removed
+	QHash<QString, CachedStatement>::iterator iterator;
+
+	for (iterator = m_statements.begin(); iterator != m_statements.end(); ++iterator)
+	{
+		if (iterator.value().query)
+		{
+			iterator.value().query->finish();
+
+			delete iterator.value().query;
+		}
+	}
+
+	m_statements.clear();
+	m_queries.clear();
+}
+
+QSqlQuery* SqlStatementCache::getQuery(const QString &statement)
+{
+	if (m_statements.contains(statement))
+	{
+		QSqlQuery *query = m_statements[statement].query;
+		query->finish();
+
+		return query;
+	}
+
+	if (!QSqlDatabase::contains(m_connection))
+	{
+		return NULL;
+	}
+
+	QSqlQuery *query = new QSqlQuery(QSqlDatabase::database(m_connection, false));
+	query->setForwardOnly(true);
+
+	if (!query->prepare(statement))
+	{
+		delete query;
+
+		return NULL;
+	}
+
+	CachedStatement cachedStatement;
+	cachedStatement.query = query;
+
+	m_statements[statement] = cachedStatement;
+	m_queries[query] = statement;
+
+	return query;
+}
+
+QList<SqlStatementCache::StatementStatistics> SqlStatementCache::getStatistics() const
+{
+	QList<StatementStatistics> statistics;
+	QHash<QString, CachedStatement>::const_iterator iterator;
+
+	for (iterator = m_statements.constBegin(); iterator != m_statements.constEnd(); ++iterator)
+	{
+		StatementStatistics statementStatistics;
+		statementStatistics.statement = iterator.key();
+		statementStatistics.executions = iterator.value().executions;
+		statementStatistics.time = iterator.value().time;
+
+		statistics.append(statementStatistics);
+	}
+
+	return statistics;
+}
+
+int SqlStatementCache::execBatch(const QString &statement, const QList<qint64> &identifiers)
+{
+	if (identifiers.isEmpty())
+	{
+		return 0;
+	}
+
+// identifiers are bound in fixed size chunks, last chunk is padded with repeated identifier so single statement serves all of them
+	QStringList placeholders;
+
+	for (int i = 0; i < BATCH_SIZE; ++i)
+	{
+		placeholders.append(QLatin1String("?"));
+	}
+
+	QSqlQuery *query = getQuery(statement.arg(placeholders.join(QLatin1String(", "))));
+
+	if (!query)
+	{
+		return -1;
+	}
+
+	int amount = 0;
+
+	for (int i = 0; i < identifiers.count(); i += BATCH_SIZE)
+	{
+		QVariantList values;
+
+		for (int j = 0; j < BATCH_SIZE; ++j)
+		{
+			values.append(identifiers.at(qMin((i + j), (identifiers.count() - 1))));
+		}
+
+		if (!exec(query, values))
+		{
+			return -1;
+		}
+
+		amount += qMax(0, query->numRowsAffected());
+
+		query->finish();
+	}
+
+	return amount;
+}
+
+bool SqlStatementCache::exec(QSqlQuery *query, const QVariantList &values)
+{
+	if (!query)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < values.count(); ++i)
+	{
+		query->bindValue(i, values.at(i));
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	const bool result = query->exec();
+
+	if (m_queries.contains(query))
+	{
+		CachedStatement &cachedStatement = m_statements[m_queries[query]];
+		++cachedStatement.executions;
+		cachedStatement.time += (timer.nsecsElapsed() / 1000);
+	}
+
+	return result;
+}
+
+}
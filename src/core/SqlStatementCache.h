@@ -0,0 +1,72 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2015 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_SQLSTATEMENTCACHE_H
+#define OTTER_SQLSTATEMENTCACHE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+#include <QtSql/QSqlQuery>
+
+namespace Otter
+{
+
+class SqlStatementCache
+{
+public:
+	struct StatementStatistics
+	{
+		QString statement;
+		qint64 executions;
+		qint64 time;
+
+		StatementStatistics() : executions(0), time(0) {}
+	};
+
+	explicit SqlStatementCache(const QString &connection = QString());
+	~SqlStatementCache();
+
+	void setConnection(const QString &connection);
+	void clear();
+	QSqlQuery* getQuery(const QString &statement);
+	QList<StatementStatistics> getStatistics() const;
+	int execBatch(const QString &statement, const QList<qint64> &identifiers);
+	bool exec(QSqlQuery *query, const QVariantList &values = QVariantList());
+
+	static const int BATCH_SIZE = 100;
+
+private:
+	struct CachedStatement
+	{
+		QSqlQuery *query;
+		qint64 executions;
+		qint64 time;
+
+		CachedStatement() : query(NULL), executions(0), time(0) {}
+	};
+
+	QString m_connection;
+	QHash<QString, CachedStatement> m_statements;
+	QHash<QSqlQuery*, QString> m_queries;
+};
+
+}
+
+#endif
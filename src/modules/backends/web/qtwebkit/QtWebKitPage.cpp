@@ -54,8 +54,10 @@ QtWebKitPage::QtWebKitPage(QtWebKitNetworkManager *networkManager, QtWebKitWebWi
 	updateStyleSheets();
 	optionChanged(QLatin1String("Interface/ShowScrollBars"), SettingsManager::getValue(QLatin1String("Interface/ShowScrollBars")));
 
+	SettingsManager::addListener(QLatin1String("Content/"), this, SLOT(optionChanged(QString,QVariant)));
+	SettingsManager::addListener(QLatin1String("Interface/ShowScrollBars"), this, SLOT(optionChanged(QString,QVariant)));
+
 	connect(this, SIGNAL(loadFinished(bool)), this, SLOT(pageLoadFinished()));
-	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString,QVariant)));
 }
 
 QtWebKitPage::QtWebKitPage() : QWebPage(),
@@ -80,50 +82,12 @@ void QtWebKitPage::pageLoadFinished()
 	m_ignoreJavaScriptPopups = false;
 
 	updateStyleSheets();
-
-	if (m_widget)
-	{
-		const QStringList domainList = ContentBlockingManager::createSubdomainList(m_widget->getUrl().host());
-
-		for (int i = 0; i < domainList.count(); ++i)
-		{
-			applyContentBlockingRules(ContentBlockingManager::getStyleSheetBlackList(m_widget->getContentBlockingProfiles()).values(domainList.at(i)), true);
-			applyContentBlockingRules(ContentBlockingManager::getStyleSheetWhiteList(m_widget->getContentBlockingProfiles()).values(domainList.at(i)), false);
-		}
-	}
-}
-
-void QtWebKitPage::applyContentBlockingRules(const QStringList &rules, bool remove)
-{
-	for (int i = 0; i < rules.count(); ++i)
-	{
-		const QWebElementCollection elements = mainFrame()->documentElement().findAll(rules.at(i));
-
-		for (int j = 0; j < elements.count(); ++j)
-		{
-			QWebElement element = elements.at(j);
-
-			if (element.isNull())
-			{
-				continue;
-			}
-
-			if (remove)
-			{
-				element.removeFromDocument();
-			}
-			else
-			{
-				element.setStyleProperty(QLatin1String("display"), QLatin1String("block"));
-			}
-		}
-	}
 }
 
 void QtWebKitPage::updateStyleSheets(const QUrl &url)
 {
 	const QUrl currentUrl = (url.isEmpty() ? mainFrame()->url() : url);
-	QString styleSheet = QString(QStringLiteral("html {color: %1;} a {color: %2;} a:visited {color: %3;}")).arg(SettingsManager::getValue(QLatin1String("Content/TextColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/LinkColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/VisitedLinkColor")).toString()).toUtf8() + (m_widget ? ContentBlockingManager::getStyleSheet(m_widget->getContentBlockingProfiles()) : QByteArray());
+	QString styleSheet = QString(QStringLiteral("html {color: %1;} a {color: %2;} a:visited {color: %3;}")).arg(SettingsManager::getValue(QLatin1String("Content/TextColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/LinkColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/VisitedLinkColor")).toString()).toUtf8() + (m_widget ? ContentBlockingManager::getStyleSheet(m_widget->getContentBlockingProfiles(), currentUrl.host()) : QByteArray());
 	QWebElement image = mainFrame()->findFirstElement(QLatin1String("img"));
 
 	if (!image.isNull() && QUrl(image.attribute(QLatin1String("src"))) == currentUrl)
@@ -125,8 +125,11 @@ QtWebKitWebWidget::QtWebKitWebWidget(bool isPrivate, WebBackend *backend, QtWebK
 	updateEditActions();
 	setZoom(SettingsManager::getValue(QLatin1String("Content/DefaultZoom")).toInt());
 
+	SettingsManager::addListener(QLatin1String("Browser/JavaScriptCanShowStatusMessages"), this, SLOT(optionChanged(QString,QVariant)));
+	SettingsManager::addListener(QLatin1String("Content/BackgroundColor"), this, SLOT(optionChanged(QString,QVariant)));
+	SettingsManager::addListener(QLatin1String("History/BrowsingLimitAmountWindow"), this, SLOT(optionChanged(QString,QVariant)));
+
 	connect(BookmarksManager::getModel(), SIGNAL(modelModified()), this, SLOT(updateBookmarkActions()));
-	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString,QVariant)));
 	connect(m_page, SIGNAL(aboutToNavigate(QWebFrame*,QWebPage::NavigationType)), this, SLOT(navigating(QWebFrame*,QWebPage::NavigationType)));
 	connect(m_page, SIGNAL(requestedNewWindow(WebWidget*,OpenHints)), this, SIGNAL(requestedNewWindow(WebWidget*,OpenHints)));
 	connect(m_page, SIGNAL(saveFrameStateRequested(QWebFrame*,QWebHistoryItem*)), this, SLOT(saveState(QWebFrame*,QWebHistoryItem*)));
@@ -157,6 +160,8 @@ QtWebKitWebWidget::~QtWebKitWebWidget()
 {
 	m_webView->stop();
 	m_webView->settings()->setAttribute(QWebSettings::JavascriptEnabled, false);
+
+	ContentBlockingManager::unregisterProfiles(m_contentBlockingProfiles);
 }
 
 void QtWebKitWebWidget::focusInEvent(QFocusEvent *event)
@@ -480,6 +485,7 @@ void QtWebKitWebWidget::handleHistory()
 	const QUrl url = getUrl();
 	const qint64 identifier = m_page->history()->currentItem().userData().toList().value(IdentifierEntryData).toLongLong();
 
+// entries added before history database was ready use provisional negative identifiers
 	if (identifier == 0)
 	{
 		QVariantList data;
@@ -492,7 +498,7 @@ void QtWebKitWebWidget::handleHistory()
 		SessionsManager::markSessionModified();
 		BookmarksManager::updateVisits(url.toString());
 	}
-	else if (identifier > 0)
+	else if (identifier > 0 || identifier < -1)
 	{
 		HistoryManager::updateEntry(identifier, url, getTitle(), m_webView->icon());
 	}
@@ -1000,7 +1006,15 @@ void QtWebKitWebWidget::updateOptions(const QUrl &url)
 		setStatusMessage(QString());
 	}
 
-	m_contentBlockingProfiles = ContentBlockingManager::getProfileList(getOption(QLatin1String("Content/BlockingProfiles"), url).toStringList());
+	const QVector<int> contentBlockingProfiles = ContentBlockingManager::getProfileList(getOption(QLatin1String("Content/BlockingProfiles"), url).toStringList());
+
+	if (contentBlockingProfiles != m_contentBlockingProfiles)
+	{
+		ContentBlockingManager::unregisterProfiles(m_contentBlockingProfiles);
+		ContentBlockingManager::registerProfiles(contentBlockingProfiles);
+
+		m_contentBlockingProfiles = contentBlockingProfiles;
+	}
 
 	m_page->updateStyleSheets(url);
 
@@ -40,6 +40,9 @@ namespace Otter
 
 CacheContentsWidget::CacheContentsWidget(Window *window) : ContentsWidget(window),
 	m_model(new QStandardItemModel(this)),
+	m_removedAmount(0),
+	m_totalAmount(0),
+	m_isClearing(false),
 	m_isLoading(true),
 	m_ui(new Ui::CacheContentsWidget)
 {
@@ -94,6 +97,10 @@ void CacheContentsWidget::triggerAction(int identifier, bool checked)
 		case ActionsManager::DeleteAction:
 			removeDomainEntriesOrEntry();
 
+			break;
+		case ActionsManager::StopAction:
+			NetworkManagerFactory::getCache()->cancelClearing();
+
 			break;
 		case ActionsManager::FindAction:
 		case ActionsManager::QuickFindAction:
@@ -130,10 +137,16 @@ void CacheContentsWidget::populateCache()
 	m_ui->cacheView->header()->setSectionResizeMode(0, QHeaderView::Stretch);
 
 	m_isLoading = false;
+	m_isClearing = cache->isClearing();
 
-	emit loadingChanged(false);
+	if (!m_isClearing)
+	{
+		emit loadingChanged(false);
+	}
 
 	connect(cache, SIGNAL(cleared()), this, SLOT(clearEntries()));
+	connect(cache, SIGNAL(clearingProgressChanged(int,int)), this, SLOT(updateClearingProgress(int,int)));
+	connect(cache, SIGNAL(clearingFinished()), this, SLOT(handleClearingFinished()));
 	connect(cache, SIGNAL(entryAdded(QUrl)), this, SLOT(addEntry(QUrl)));
 	connect(cache, SIGNAL(entryRemoved(QUrl)), this, SLOT(removeEntry(QUrl)));
 	connect(m_model, SIGNAL(modelReset()), this, SLOT(updateActions()));
@@ -216,36 +229,23 @@ void CacheContentsWidget::addEntry(const QUrl &entry)
 	}
 
 	NetworkCache *cache = NetworkManagerFactory::getCache();
-	QIODevice *device = cache->data(entry);
-	const QNetworkCacheMetaData metaData = cache->metaData(entry);
-	const QList<QPair<QByteArray, QByteArray> > headers = metaData.rawHeaders();
-	QString type;
-
-	for (int i = 0; i < headers.count(); ++i)
-	{
-		if (headers.at(i).first == QStringLiteral("Content-Type").toLatin1())
-		{
-			type = QString(headers.at(i).second);
-
-			break;
-		}
-	}
-
-	const QMimeType mimeType = ((type.isEmpty() && device) ? QMimeDatabase().mimeTypeForData(device) : QMimeDatabase().mimeTypeForName(type));
+	const NetworkCacheEntry cacheEntry = cache->getEntry(entry);
+	QIODevice *device = (cacheEntry.type.isEmpty() ? cache->data(entry) : NULL);
+	const QMimeType mimeType = ((cacheEntry.type.isEmpty() && device) ? QMimeDatabase().mimeTypeForData(device) : QMimeDatabase().mimeTypeForName(cacheEntry.type));
 	QList<QStandardItem*> entryItems;
 	entryItems.append(new QStandardItem(entry.path()));
 	entryItems.append(new QStandardItem(mimeType.name()));
-	entryItems.append(new QStandardItem(device ? Utils::formatUnit(device->size()) : QString()));
-	entryItems.append(new QStandardItem(metaData.lastModified().toString()));
-	entryItems.append(new QStandardItem(metaData.expirationDate().toString()));
+	entryItems.append(new QStandardItem(Utils::formatUnit(cacheEntry.size)));
+	entryItems.append(new QStandardItem(cacheEntry.lastModified.toString()));
+	entryItems.append(new QStandardItem(cacheEntry.expirationDate.toString()));
 	entryItems[0]->setData(entry, Qt::UserRole);
-	entryItems[2]->setData((device ? device->size() : 0), Qt::UserRole);
+	entryItems[2]->setData(cacheEntry.size, Qt::UserRole);
 
 	QStandardItem *sizeItem = m_model->item(domainItem->row(), 2);
 
-	if (sizeItem && device)
+	if (sizeItem)
 	{
-		sizeItem->setData((sizeItem->data(Qt::UserRole).toLongLong() + device->size()), Qt::UserRole);
+		sizeItem->setData((sizeItem->data(Qt::UserRole).toLongLong() + cacheEntry.size), Qt::UserRole);
 		sizeItem->setText(Utils::formatUnit(sizeItem->data(Qt::UserRole).toLongLong()));
 	}
 
@@ -533,6 +533,40 @@ void CacheContentsWidget::updateActions()
 	}
 }
 
+void CacheContentsWidget::updateClearingProgress(int removed, int total)
+{
+	const bool wasClearing = m_isClearing;
+
+	m_removedAmount = removed;
+	m_totalAmount = total;
+	m_isClearing = true;
+
+	emit statusMessageChanged(getStatusMessage());
+
+	if (!wasClearing)
+	{
+		getAction(ActionsManager::StopAction)->setEnabled(true);
+
+		emit loadingChanged(true);
+	}
+}
+
+void CacheContentsWidget::handleClearingFinished()
+{
+	m_removedAmount = 0;
+	m_totalAmount = 0;
+	m_isClearing = false;
+
+	getAction(ActionsManager::StopAction)->setEnabled(false);
+
+	emit statusMessageChanged(QString());
+
+	if (!m_isLoading)
+	{
+		emit loadingChanged(false);
+	}
+}
+
 QStandardItem* CacheContentsWidget::findDomain(const QString &domain)
 {
 	for (int i = 0; i < m_model->rowCount(); ++i)
@@ -576,13 +610,18 @@ Action* CacheContentsWidget::getAction(int identifier)
 		return m_actions[identifier];
 	}
 
-	if (identifier != ActionsManager::DeleteAction)
+	if (identifier != ActionsManager::DeleteAction && identifier != ActionsManager::StopAction)
 	{
 		return NULL;
 	}
 
 	Action *action = new Action(identifier, this);
 
+	if (identifier == ActionsManager::StopAction)
+	{
+		action->setEnabled(m_isClearing);
+	}
+
 	m_actions[identifier] = action;
 
 	connect(action, SIGNAL(triggered()), this, SLOT(triggerAction()));
@@ -595,6 +634,21 @@ QString CacheContentsWidget::getTitle() const
 	return tr("Cache");
 }
 
+QString CacheContentsWidget::getStatusMessage() const
+{
+	if (!m_isClearing)
+	{
+		return QString();
+	}
+
+	if (m_totalAmount <= 0)
+	{
+		return tr("Removing cache files…");
+	}
+
+	return tr("Removing cache files: %1 of %2").arg(m_removedAmount).arg(m_totalAmount);
+}
+
 QLatin1String CacheContentsWidget::getType() const
 {
 	return QLatin1String("cache");
@@ -617,7 +671,7 @@ QUrl CacheContentsWidget::getEntry(const QModelIndex &index) const
 
 bool CacheContentsWidget::isLoading() const
 {
-	return m_isLoading;
+	return (m_isLoading || m_isClearing);
 }
 
 bool CacheContentsWidget::eventFilter(QObject *object, QEvent *event)
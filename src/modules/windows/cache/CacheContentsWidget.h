@@ -45,6 +45,7 @@ public:
 	void print(QPrinter *printer);
 	Action* getAction(int identifier);
 	QString getTitle() const;
+	QString getStatusMessage() const;
 	QLatin1String getType() const;
 	QUrl getUrl() const;
 	QIcon getIcon() const;
@@ -73,10 +74,15 @@ protected slots:
 	void copyEntryLink();
 	void showContextMenu(const QPoint &point);
 	void updateActions();
+	void updateClearingProgress(int removed, int total);
+	void handleClearingFinished();
 
 private:
 	QStandardItemModel *m_model;
 	QHash<int, Action*> m_actions;
+	int m_removedAmount;
+	int m_totalAmount;
+	bool m_isClearing;
 	bool m_isLoading;
 	Ui::CacheContentsWidget *m_ui;
 };
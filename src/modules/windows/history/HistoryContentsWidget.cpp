@@ -20,6 +20,7 @@
 #include "HistoryContentsWidget.h"
 #include "../../../core/ActionsManager.h"
 #include "../../../core/HistoryManager.h"
+#include "../../../core/HistoryModel.h"
 #include "../../../core/Utils.h"
 #include "../../../ui/ItemDelegate.h"
 
@@ -34,26 +35,10 @@ namespace Otter
 {
 
 HistoryContentsWidget::HistoryContentsWidget(Window *window) : ContentsWidget(window),
-	m_model(new QStandardItemModel(this)),
-	m_isLoading(true),
+	m_model(new HistoryModel(this)),
 	m_ui(new Ui::HistoryContentsWidget)
 {
 	m_ui->setupUi(this);
-
-	QStringList groups;
-	groups << tr("Today") << tr("Yesterday") << tr("Earlier This Week") << tr("Previous Week") << tr("Earlier This Month") << tr("Earlier This Year") << tr("Older");
-
-	for (int i = 0; i < groups.count(); ++i)
-	{
-		m_model->appendRow(new QStandardItem(Utils::getIcon(QLatin1String("inode-directory")), groups.at(i)));
-	}
-
-	QStringList labels;
-	labels << tr("Address") << tr("Title") << tr("Date");
-
-	m_model->setHorizontalHeaderLabels(labels);
-	m_model->setSortRole(Qt::DisplayRole);
-
 	m_ui->historyView->setModel(m_model);
 	m_ui->historyView->setItemDelegate(new ItemDelegate(this));
 	m_ui->historyView->header()->setTextElideMode(Qt::ElideRight);
@@ -76,13 +61,11 @@ HistoryContentsWidget::HistoryContentsWidget(Window *window) : ContentsWidget(wi
 		m_ui->historyView->expandAll();
 	}
 
-	QTimer::singleShot(100, this, SLOT(populateEntries()));
+	QTimer::singleShot(100, m_model, SLOT(reload()));
 
-	connect(HistoryManager::getInstance(), SIGNAL(cleared()), this, SLOT(populateEntries()));
-	connect(HistoryManager::getInstance(), SIGNAL(entryAdded(qint64)), this, SLOT(addEntry(qint64)));
-	connect(HistoryManager::getInstance(), SIGNAL(entryUpdated(qint64)), this, SLOT(updateEntry(qint64)));
-	connect(HistoryManager::getInstance(), SIGNAL(entryRemoved(qint64)), this, SLOT(removeEntry(qint64)));
-	connect(HistoryManager::getInstance(), SIGNAL(dayChanged()), this, SLOT(populateEntries()));
+	connect(m_model, SIGNAL(loadingChanged(bool)), this, SIGNAL(loadingChanged(bool)));
+	connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(updateGroups()));
+	connect(m_model, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(updateGroups()));
 	connect(m_ui->filterLineEdit, SIGNAL(textChanged(QString)), this, SLOT(filterHistory(QString)));
 	connect(m_ui->historyView, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(openEntry(QModelIndex)));
 	connect(m_ui->historyView, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(showContextMenu(QPoint)));
@@ -132,172 +115,23 @@ void HistoryContentsWidget::print(QPrinter *printer)
 
 void HistoryContentsWidget::filterHistory(const QString &filter)
 {
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (!groupItem)
-		{
-			continue;
-		}
-
-		bool found = (filter.isEmpty() && groupItem->rowCount() > 0);
-
-		for (int j = 0; j < groupItem->rowCount(); ++j)
-		{
-			QStandardItem *entryItem = groupItem->child(j, 0);
-
-			if (!entryItem)
-			{
-				continue;
-			}
-
-			const bool match = (filter.isEmpty() || entryItem->text().contains(filter, Qt::CaseInsensitive) || groupItem->child(j, 1)->text().contains(filter, Qt::CaseInsensitive));
-
-			if (match)
-			{
-				found = true;
-			}
-
-			m_ui->historyView->setRowHidden(j, groupItem->index(), !match);
-		}
-
-		m_ui->historyView->setRowHidden(i, m_model->invisibleRootItem()->index(), !found);
-		m_ui->historyView->setExpanded(groupItem->index(), !filter.isEmpty());
-	}
-}
-
-void HistoryContentsWidget::populateEntries()
-{
-	const QDate date = QDate::currentDate();
-	QList<QDate> dates;
-	dates << date << date.addDays(-1) << date.addDays(-7) << date.addDays(-14) << date.addDays(-30) << date.addDays(-365);
-
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (groupItem)
-		{
-			groupItem->setData(dates.value(i, QDate()), Qt::UserRole);
-			groupItem->removeRows(0, groupItem->rowCount());
-		}
-	}
-
-	const QList<HistoryEntry> entries = HistoryManager::getEntries();
-
-	for (int i = 0; i < entries.count(); ++i)
-	{
-		addEntry(entries.at(i));
-	}
+	m_model->setFilter(filter);
 
 	for (int i = 0; i < m_model->rowCount(); ++i)
 	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (groupItem)
-		{
-			groupItem->sortChildren(2, Qt::DescendingOrder);
-		}
+		m_ui->historyView->setExpanded(m_model->index(i, 0), !filter.isEmpty());
 	}
-
-	m_isLoading = false;
-
-	emit loadingChanged(false);
 }
 
-void HistoryContentsWidget::addEntry(qint64 entry)
+void HistoryContentsWidget::updateGroups()
 {
-	addEntry(HistoryManager::getEntry(entry));
-}
-
-void HistoryContentsWidget::addEntry(const HistoryEntry &entry)
-{
-	if (entry.identifier < 0)
-	{
-		return;
-	}
-
-	QStandardItem *groupItem = NULL;
-
 	for (int i = 0; i < m_model->rowCount(); ++i)
 	{
-		groupItem = m_model->item(i, 0);
-
-		if (groupItem && (entry.time.date() >= groupItem->data(Qt::UserRole).toDate() || !groupItem->data(Qt::UserRole).toDate().isValid()))
-		{
-			break;
-		}
-
-		groupItem = NULL;
-	}
-
-	if (!groupItem)
-	{
-		return;
-	}
-
-	QList<QStandardItem*> entryItems;
-	entryItems.append(new QStandardItem((entry.icon.isNull() ? Utils::getIcon(QLatin1String("text-html")) : entry.icon), entry.url.toString().replace(QLatin1String("%23"), QString(QLatin1Char('#')))));
-	entryItems.append(new QStandardItem(entry.title.isEmpty() ? tr("(Untitled)") : entry.title));
-	entryItems.append(new QStandardItem(entry.time.toString()));
-	entryItems[0]->setData(entry.identifier, Qt::UserRole);
-
-	groupItem->appendRow(entryItems);
-
-	m_ui->historyView->setRowHidden(groupItem->row(), groupItem->index().parent(), false);
-
-	if (sender())
-	{
-		groupItem->sortChildren(2, Qt::DescendingOrder);
-	}
-
-	if (!m_ui->filterLineEdit->text().isEmpty())
-	{
-		filterHistory(m_ui->filterLineEdit->text());
-	}
-}
-
-void HistoryContentsWidget::updateEntry(qint64 entry)
-{
-	QStandardItem *entryItem = findEntry(entry);
-
-	if (!entryItem)
-	{
-		addEntry(entry);
-
-		return;
-	}
-
-	HistoryEntry historyEntry = HistoryManager::getEntry(entry);
-
-	entryItem->setIcon(historyEntry.icon.isNull() ? Utils::getIcon(QLatin1String("text-html")) : historyEntry.icon);
-	entryItem->setText(historyEntry.url.toString());
-	entryItem->parent()->child(entryItem->row(), 1)->setText(historyEntry.title.isEmpty() ? tr("(Untitled)") : historyEntry.title);
-	entryItem->parent()->child(entryItem->row(), 2)->setText(historyEntry.time.toString());
-
-	if (!m_ui->filterLineEdit->text().isEmpty())
-	{
-		filterHistory(m_ui->filterLineEdit->text());
-	}
-}
-
-void HistoryContentsWidget::removeEntry(qint64 entry)
-{
-	QStandardItem *entryItem = findEntry(entry);
-
-	if (entryItem)
-	{
-		QStandardItem *groupItem = entryItem->parent();
+		QStandardItem *groupItem = m_model->item(i, 0);
 
 		if (groupItem)
 		{
-			m_model->removeRow(entryItem->row(), groupItem->index());
-
-			if (groupItem->rowCount() == 0)
-			{
-				m_ui->historyView->setRowHidden(groupItem->row(), m_model->invisibleRootItem()->index(), true);
-			}
+			m_ui->historyView->setRowHidden(i, m_model->invisibleRootItem()->index(), (groupItem->rowCount() == 0));
 		}
 	}
 }
@@ -314,37 +148,12 @@ void HistoryContentsWidget::removeEntry()
 
 void HistoryContentsWidget::removeDomainEntries()
 {
-	QStandardItem *domainItem = findEntry(getEntry(m_ui->historyView->currentIndex()));
+	QStandardItem *domainItem = m_model->getEntryItem(getEntry(m_ui->historyView->currentIndex()));
 
-	if (!domainItem)
+	if (domainItem)
 	{
-		return;
-	}
-
-	const QString host = QUrl(domainItem->text()).host();
-	QList<qint64> entries;
-
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (!groupItem)
-		{
-			continue;
-		}
-
-		for (int j = (groupItem->rowCount() - 1); j >= 0; --j)
-		{
-			QStandardItem *entryItem = groupItem->child(j, 0);
-
-			if (entryItem && host == QUrl(entryItem->text()).host())
-			{
-				entries.append(entryItem->data(Qt::UserRole).toLongLong());
-			}
-		}
+		HistoryManager::removeEntries(QUrl(domainItem->text()).host());
 	}
-
-	HistoryManager::removeEntries(entries);
 }
 
 void HistoryContentsWidget::openEntry(const QModelIndex &index)
@@ -368,7 +177,7 @@ void HistoryContentsWidget::openEntry(const QModelIndex &index)
 
 void HistoryContentsWidget::bookmarkEntry()
 {
-	QStandardItem *entryItem = findEntry(getEntry(m_ui->historyView->currentIndex()));
+	QStandardItem *entryItem = m_model->getEntryItem(getEntry(m_ui->historyView->currentIndex()));
 
 	if (entryItem)
 	{
@@ -378,7 +187,7 @@ void HistoryContentsWidget::bookmarkEntry()
 
 void HistoryContentsWidget::copyEntryLink()
 {
-	QStandardItem *entryItem = findEntry(getEntry(m_ui->historyView->currentIndex()));
+	QStandardItem *entryItem = m_model->getEntryItem(getEntry(m_ui->historyView->currentIndex()));
 
 	if (entryItem)
 	{
@@ -412,29 +221,6 @@ void HistoryContentsWidget::showContextMenu(const QPoint &point)
 	menu.exec(m_ui->historyView->mapToGlobal(point));
 }
 
-QStandardItem* HistoryContentsWidget::findEntry(qint64 entry)
-{
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (groupItem)
-		{
-			for (int j = 0; j < groupItem->rowCount(); ++j)
-			{
-				QStandardItem *entryItem = groupItem->child(j, 0);
-
-				if (entryItem && entry == entryItem->data(Qt::UserRole).toLongLong())
-				{
-					return entryItem;
-				}
-			}
-		}
-	}
-
-	return NULL;
-}
-
 QString HistoryContentsWidget::getTitle() const
 {
 	return tr("History");
@@ -462,7 +248,7 @@ qint64 HistoryContentsWidget::getEntry(const QModelIndex &index) const
 
 bool HistoryContentsWidget::isLoading() const
 {
-	return m_isLoading;
+	return m_model->isLoading();
 }
 
 bool HistoryContentsWidget::eventFilter(QObject *object, QEvent *event)
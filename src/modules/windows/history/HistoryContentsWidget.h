@@ -22,8 +22,6 @@
 
 #include "../../../ui/ContentsWidget.h"
 
-#include <QtGui/QStandardItemModel>
-
 namespace Otter
 {
 
@@ -32,8 +30,7 @@ namespace Ui
 	class HistoryContentsWidget;
 }
 
-struct HistoryEntry;
-
+class HistoryModel;
 class Window;
 
 class HistoryContentsWidget : public ContentsWidget
@@ -57,16 +54,11 @@ public slots:
 
 protected:
 	void changeEvent(QEvent *event);
-	QStandardItem* findEntry(qint64 entry);
 	qint64 getEntry(const QModelIndex &index) const;
 
 protected slots:
 	void filterHistory(const QString &filter);
-	void populateEntries();
-	void addEntry(qint64 entry);
-	void addEntry(const HistoryEntry &entry);
-	void updateEntry(qint64 entry);
-	void removeEntry(qint64 entry);
+	void updateGroups();
 	void removeEntry();
 	void removeDomainEntries();
 	void openEntry(const QModelIndex &index = QModelIndex());
@@ -75,8 +67,7 @@ protected slots:
 	void showContextMenu(const QPoint &point);
 
 private:
-	QStandardItemModel *m_model;
-	bool m_isLoading;
+	HistoryModel *m_model;
 	Ui::HistoryContentsWidget *m_ui;
 };
 
@@ -89,7 +89,11 @@ TabBarWidget::TabBarWidget(QWidget *parent) : QTabBar(parent),
 		connect(toolBar, SIGNAL(areaChanged(Qt::ToolBarArea)), this, SLOT(setArea(Qt::ToolBarArea)));
 	}
 
-	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString,QVariant)));
+	SettingsManager::addListener(QLatin1String("TabBar/ShowCloseButton"), this, SLOT(optionChanged(QString,QVariant)));
+	SettingsManager::addListener(QLatin1String("TabBar/ShowUrlIcon"), this, SLOT(optionChanged(QString,QVariant)));
+	SettingsManager::addListener(QLatin1String("TabBar/EnablePreviews"), this, SLOT(optionChanged(QString,QVariant)));
+	SettingsManager::addListener(QLatin1String("TabBar/MinimumTabSize"), this, SLOT(optionChanged(QString,QVariant)));
+
 	connect(this, SIGNAL(currentChanged(int)), this, SLOT(currentTabChanged(int)));
 }
 